@@ -0,0 +1,79 @@
+#include "async_search.h"
+#include <algorithm>
+using namespace std;
+
+SearchExecutor::SearchExecutor(size_t thread_count) {
+    thread_count = max<size_t>(thread_count, 1);
+    workers_.reserve(thread_count);
+    for (size_t i = 0; i < thread_count; ++i) {
+        workers_.emplace_back([this] { Work(); });
+    }
+}
+
+SearchExecutor::~SearchExecutor() {
+    {
+        lock_guard lock(mutex_);
+        is_stopping_ = true;
+    }
+    task_added_.notify_all();
+    for (thread& worker : workers_) {
+        worker.join();
+    }
+}
+
+void SearchExecutor::Submit(function<void()> task) {
+    {
+        lock_guard lock(mutex_);
+        tasks_.push_back(move(task));
+    }
+    task_added_.notify_one();
+}
+
+size_t SearchExecutor::GetThreadCount() const {
+    return workers_.size();
+}
+
+void SearchExecutor::Work() {
+    while (true) {
+        function<void()> task;
+        {
+            unique_lock lock(mutex_);
+            task_added_.wait(lock, [this] { return is_stopping_ || !tasks_.empty(); });
+            if (tasks_.empty()) {
+                return;
+            }
+            task = move(tasks_.front());
+            tasks_.pop_front();
+        }
+        task();
+    }
+}
+
+SearchExecutor& GetDefaultSearchExecutor() {
+    static SearchExecutor executor;
+    return executor;
+}
+
+future<SearchResult> FindTopDocumentsAsync(const SearchServer& search_server, string raw_query,
+    SearchLimits limits, DocumentStatus status, SearchExecutor& executor) {
+    return FindTopDocumentsAsync(search_server, move(raw_query), move(limits),
+        [status](int document_id, DocumentStatus document_status, int rating) {
+            return document_status == status;
+        }, executor);
+}
+
+void FindTopDocumentsWithCallback(const SearchServer& search_server, string raw_query,
+    SearchLimits limits, SearchCallback on_complete, DocumentStatus status, SearchExecutor& executor) {
+    executor.Submit(
+        [&search_server, raw_query = move(raw_query), limits = move(limits), on_complete = move(on_complete), status]() {
+            SearchResult result;
+            exception_ptr error;
+            try {
+                result = search_server.FindTopDocuments(raw_query, limits, status);
+            }
+            catch (...) {
+                error = current_exception();
+            }
+            on_complete(move(result), error);
+        });
+}
@@ -0,0 +1,74 @@
+#pragma once
+#include "search_server.h"
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Fixed pool of worker threads running tasks in submission order.
+// The destructor finishes the queued tasks and joins the workers.
+class SearchExecutor {
+public:
+    explicit SearchExecutor(size_t thread_count = std::thread::hardware_concurrency());
+    ~SearchExecutor();
+
+    SearchExecutor(const SearchExecutor&) = delete;
+    SearchExecutor& operator=(const SearchExecutor&) = delete;
+
+    // The task must not throw
+    void Submit(std::function<void()> task);
+    size_t GetThreadCount() const;
+
+private:
+    void Work();
+
+    std::mutex mutex_;
+    std::condition_variable task_added_;
+    std::deque<std::function<void()>> tasks_;
+    bool is_stopping_ = false;
+    std::vector<std::thread> workers_;
+};
+
+// Shared by the functions below unless an executor is passed explicitly
+SearchExecutor& GetDefaultSearchExecutor();
+
+// The query is copied. Destroying the future does not wait for the search, so the
+// search server must outlive the search itself: until the future becomes ready.
+// A query cancelled or expired while queued still runs once dequeued, until its
+// first limits check after SEARCH_LIMITS_CHECK_INTERVAL postings.
+template <typename DocumentPredicate>
+std::future<SearchResult> FindTopDocumentsAsync(const SearchServer& search_server, std::string raw_query,
+    SearchLimits limits, DocumentPredicate document_predicate, SearchExecutor& executor = GetDefaultSearchExecutor()) {
+    auto promise = std::make_shared<std::promise<SearchResult>>();
+    auto result = promise->get_future();
+    executor.Submit(
+        [&search_server, raw_query = std::move(raw_query), limits = std::move(limits), document_predicate, promise]() {
+            try {
+                promise->set_value(search_server.FindTopDocuments(raw_query, limits, document_predicate));
+            }
+            catch (...) {
+                promise->set_exception(std::current_exception());
+            }
+        });
+    return result;
+}
+
+std::future<SearchResult> FindTopDocumentsAsync(const SearchServer& search_server, std::string raw_query,
+    SearchLimits limits, DocumentStatus status = DocumentStatus::ACTUAL,
+    SearchExecutor& executor = GetDefaultSearchExecutor());
+
+// The callback runs on an executor thread and receives either the result or the
+// exception thrown while parsing the query; it must not throw itself.
+// The call returns immediately; the search server must outlive the callback.
+// Queued queries behave like those of FindTopDocumentsAsync under cancellation.
+using SearchCallback = std::function<void(SearchResult result, std::exception_ptr error)>;
+
+void FindTopDocumentsWithCallback(const SearchServer& search_server, std::string raw_query,
+    SearchLimits limits, SearchCallback on_complete, DocumentStatus status = DocumentStatus::ACTUAL,
+    SearchExecutor& executor = GetDefaultSearchExecutor());
@@ -0,0 +1,197 @@
+#include "corpus_loader.h"
+#include <charconv>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <system_error>
+#include <thread>
+#include <unistd.h>
+using namespace std;
+
+namespace {
+
+const size_t MIN_CHUNK_SIZE = 1024 * 1024;
+
+class MappedFile {
+public:
+    explicit MappedFile(const string& path) {
+        const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            throw system_error(errno, generic_category(), "Cannot open corpus "s + path);
+        }
+        struct stat file_stat {};
+        if (fstat(fd, &file_stat) < 0) {
+            const int error = errno;
+            close(fd);
+            throw system_error(error, generic_category(), "fstat"s);
+        }
+        size_ = static_cast<size_t>(file_stat.st_size);
+        if (size_ > 0) {
+            data_ = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        }
+        const int error = errno;
+        close(fd);
+        if (data_ == MAP_FAILED) {
+            throw system_error(error, generic_category(), "mmap"s);
+        }
+        if (data_) {
+            madvise(data_, size_, MADV_SEQUENTIAL);
+        }
+    }
+
+    ~MappedFile() {
+        if (data_) {
+            munmap(data_, size_);
+        }
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    string_view GetText() const {
+        return { static_cast<const char*>(data_), size_ };
+    }
+
+private:
+    void* data_ = nullptr;
+    size_t size_ = 0;
+};
+
+struct CorpusRecord {
+    int document_id;
+    DocumentStatus status;
+    // Range of the record ratings in ParsedChunk::ratings
+    size_t ratings_begin;
+    size_t ratings_end;
+    string_view text;
+};
+
+struct ParsedChunk {
+    vector<CorpusRecord> records;
+    vector<int> ratings;
+    exception_ptr error;
+};
+
+int ParseCorpusInt(string_view text) {
+    int value = 0;
+    const auto [ptr, error] = from_chars(text.data(), text.data() + text.size(), value);
+    if (error != errc{} || ptr != text.data() + text.size()) {
+        throw invalid_argument("Invalid number in corpus: "s + string(text));
+    }
+    return value;
+}
+
+string_view NextCorpusField(string_view& line) {
+    const size_t tab = line.find('\t');
+    if (tab == line.npos) {
+        throw invalid_argument("Missing field in corpus line: "s + string(line));
+    }
+    const string_view field = line.substr(0, tab);
+    line.remove_prefix(tab + 1);
+    return field;
+}
+
+void ParseTsvLine(string_view line, ParsedChunk& chunk) {
+    CorpusRecord record;
+    record.document_id = ParseCorpusInt(NextCorpusField(line));
+    const int status = ParseCorpusInt(NextCorpusField(line));
+    if (status < static_cast<int>(DocumentStatus::ACTUAL) || status > static_cast<int>(DocumentStatus::REMOVED)) {
+        throw invalid_argument("Invalid document status in corpus"s);
+    }
+    record.status = static_cast<DocumentStatus>(status);
+    string_view ratings = NextCorpusField(line);
+    record.ratings_begin = chunk.ratings.size();
+    while (!ratings.empty()) {
+        const size_t comma = ratings.find(',');
+        chunk.ratings.push_back(ParseCorpusInt(ratings.substr(0, comma)));
+        ratings.remove_prefix(comma == ratings.npos ? ratings.size() : comma + 1);
+    }
+    record.ratings_end = chunk.ratings.size();
+    record.text = line;
+    chunk.records.push_back(record);
+}
+
+ParsedChunk ParseChunk(string_view text, CorpusFormat format) {
+    ParsedChunk chunk;
+    try {
+        while (!text.empty()) {
+            const size_t line_end = text.find('\n');
+            string_view line = text.substr(0, line_end);
+            text.remove_prefix(line_end == text.npos ? text.size() : line_end + 1);
+            if (!line.empty() && line.back() == '\r') {
+                line.remove_suffix(1);
+            }
+            if (line.empty()) {
+                continue;
+            }
+            if (format == CorpusFormat::TSV) {
+                ParseTsvLine(line, chunk);
+            }
+            else {
+                // The id is the position inside the chunk until the chunk offsets are known
+                chunk.records.push_back({ static_cast<int>(chunk.records.size()), DocumentStatus::ACTUAL, 0, 0, line });
+            }
+        }
+    }
+    catch (...) {
+        chunk.error = current_exception();
+    }
+    return chunk;
+}
+
+vector<string_view> SplitIntoChunks(string_view text) {
+    const size_t chunk_count = max<size_t>(1, min<size_t>(thread::hardware_concurrency() * 4, text.size() / MIN_CHUNK_SIZE));
+    const size_t chunk_size = text.size() / chunk_count + 1;
+    vector<string_view> chunks;
+    while (!text.empty()) {
+        size_t chunk_end = text.find('\n', min(chunk_size, text.size()) - 1);
+        chunk_end = chunk_end == text.npos ? text.size() : chunk_end + 1;
+        chunks.push_back(text.substr(0, chunk_end));
+        text.remove_prefix(chunk_end);
+    }
+    return chunks;
+}
+
+}
+
+double CorpusLoadStats::GetMegabytesPerSecond() const {
+    return elapsed.count() > 0 ? byte_count / 1e6 / elapsed.count() : 0.0;
+}
+
+CorpusLoadStats LoadCorpus(SearchServer& search_server, const string& path, CorpusFormat format) {
+    const auto start_time = chrono::steady_clock::now();
+    const MappedFile file(path);
+    const string_view text = file.GetText();
+
+    const vector<string_view> chunk_texts = SplitIntoChunks(text);
+    vector<ParsedChunk> chunks(chunk_texts.size());
+    transform(execution::par, chunk_texts.begin(), chunk_texts.end(), chunks.begin(), [format](string_view chunk_text) {
+        return ParseChunk(chunk_text, format);
+        });
+
+    CorpusLoadStats stats;
+    stats.byte_count = text.size();
+    vector<int> ratings;
+    for (const ParsedChunk& chunk : chunks) {
+        if (chunk.error) {
+            rethrow_exception(chunk.error);
+        }
+        const int first_document_id = static_cast<int>(stats.document_count);
+        for (const CorpusRecord& record : chunk.records) {
+            ratings.assign(chunk.ratings.begin() + record.ratings_begin, chunk.ratings.begin() + record.ratings_end);
+            const int document_id = format == CorpusFormat::LINES ? first_document_id + record.document_id : record.document_id;
+            search_server.AddDocument(document_id, record.text, record.status, ratings);
+        }
+        stats.document_count += chunk.records.size();
+    }
+    stats.elapsed = chrono::steady_clock::now() - start_time;
+    return stats;
+}
+
+ostream& operator<<(ostream& out, const CorpusLoadStats& stats) {
+    out << "documents = " << stats.document_count
+        << ", bytes = " << stats.byte_count
+        << ", elapsed = " << stats.elapsed.count() << " s"
+        << ", throughput = " << stats.GetMegabytesPerSecond() << " MB/s";
+    return out;
+}
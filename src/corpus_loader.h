@@ -0,0 +1,26 @@
+#pragma once
+#include "search_server.h"
+#include <chrono>
+#include <iostream>
+#include <string>
+
+enum class CorpusFormat {
+    // One document text per line, ids are assigned in line order starting from 0
+    LINES,
+    // <id>\t<status>\t<rating,rating,...>\t<text> per line
+    TSV,
+};
+
+struct CorpusLoadStats {
+    size_t byte_count = 0;
+    size_t document_count = 0;
+    std::chrono::duration<double> elapsed{};
+
+    double GetMegabytesPerSecond() const;
+};
+
+// Maps the file into memory, parses chunks split at line boundaries in parallel
+// and adds the documents straight from the mapped text without copying lines.
+CorpusLoadStats LoadCorpus(SearchServer& search_server, const std::string& path, CorpusFormat format = CorpusFormat::TSV);
+
+std::ostream& operator<<(std::ostream& out, const CorpusLoadStats& stats);
@@ -0,0 +1,158 @@
+#include "load_generator.h"
+#include <algorithm>
+#include <cerrno>
+#include <deque>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <system_error>
+#include <thread>
+#include <unistd.h>
+using namespace std;
+
+namespace {
+
+using Clock = chrono::steady_clock;
+
+struct ConnectionReport {
+    vector<Clock::duration> latencies;
+    size_t error_count = 0;
+};
+
+void SendAll(int fd, string_view data) {
+    while (!data.empty()) {
+        const ssize_t sent = send(fd, data.data(), data.size(), MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw system_error(errno, generic_category(), "send");
+        }
+        data.remove_prefix(sent);
+    }
+}
+
+// Reads from the socket until buffer holds a complete frame and returns whether it is an error response
+bool ReceiveResponse(int fd, string& buffer) {
+    char chunk[64 * 1024];
+    while (true) {
+        size_t offset = 0;
+        if (const auto payload = NextFrame(buffer, offset)) {
+            const bool is_error = IsErrorResponse(*payload);
+            buffer.erase(0, offset);
+            return is_error;
+        }
+        const ssize_t received = recv(fd, chunk, sizeof(chunk), 0);
+        if (received < 0 && errno == EINTR) {
+            continue;
+        }
+        if (received <= 0) {
+            throw runtime_error("Connection closed by server"s);
+        }
+        buffer.append(chunk, received);
+    }
+}
+
+ConnectionReport RunConnection(const LoadGeneratorConfig& config, size_t request_count, size_t first_query) {
+    ConnectionReport report;
+    report.latencies.reserve(request_count);
+    const int fd = ConnectTo(config.endpoint);
+    try {
+        deque<Clock::time_point> send_times;
+        string input;
+        size_t sent = 0;
+        while (report.latencies.size() < request_count) {
+            string frames;
+            while (sent < request_count && send_times.size() < config.pipeline_depth) {
+                QueryRequest request;
+                request.text = config.queries[(first_query + sent) % config.queries.size()];
+                AppendFrame(frames, EncodeRequest(request));
+                send_times.push_back(Clock::now());
+                ++sent;
+            }
+            SendAll(fd, frames);
+
+            if (ReceiveResponse(fd, input)) {
+                ++report.error_count;
+            }
+            report.latencies.push_back(Clock::now() - send_times.front());
+            send_times.pop_front();
+        }
+    }
+    catch (...) {
+        close(fd);
+        throw;
+    }
+    close(fd);
+    return report;
+}
+
+chrono::microseconds Percentile(vector<Clock::duration>& latencies, double fraction) {
+    if (latencies.empty()) {
+        return {};
+    }
+    const auto position = latencies.begin() + static_cast<ptrdiff_t>(fraction * (latencies.size() - 1));
+    nth_element(latencies.begin(), position, latencies.end());
+    return chrono::duration_cast<chrono::microseconds>(*position);
+}
+
+}
+
+double LoadReport::GetRequestsPerSecond() const {
+    return elapsed.count() > 0 ? request_count / elapsed.count() : 0.0;
+}
+
+LoadReport RunLoadGenerator(const LoadGeneratorConfig& config) {
+    if (config.queries.empty() || config.connection_count == 0 || config.pipeline_depth == 0) {
+        throw invalid_argument("Load generator needs queries, connections and a positive pipeline depth"s);
+    }
+
+    vector<ConnectionReport> connection_reports(config.connection_count);
+    vector<exception_ptr> errors(config.connection_count);
+    vector<thread> threads;
+    const auto start_time = Clock::now();
+    for (size_t i = 0; i < config.connection_count; ++i) {
+        const size_t request_count = config.request_count / config.connection_count
+            + (i < config.request_count % config.connection_count ? 1 : 0);
+        threads.emplace_back([&, i, request_count]() {
+            try {
+                connection_reports[i] = RunConnection(config, request_count, i * request_count);
+            }
+            catch (...) {
+                errors[i] = current_exception();
+            }
+            });
+    }
+    for (thread& worker : threads) {
+        worker.join();
+    }
+
+    LoadReport report;
+    report.elapsed = Clock::now() - start_time;
+    for (const exception_ptr& error : errors) {
+        if (error) {
+            rethrow_exception(error);
+        }
+    }
+
+    vector<Clock::duration> latencies;
+    for (ConnectionReport& connection_report : connection_reports) {
+        latencies.insert(latencies.end(), connection_report.latencies.begin(), connection_report.latencies.end());
+        report.error_count += connection_report.error_count;
+    }
+    report.request_count = latencies.size();
+    report.latency_p50 = Percentile(latencies, 0.5);
+    report.latency_p99 = Percentile(latencies, 0.99);
+    report.latency_max = Percentile(latencies, 1.0);
+    return report;
+}
+
+ostream& operator<<(ostream& out, const LoadReport& report) {
+    out << "requests = " << report.request_count
+        << ", errors = " << report.error_count
+        << ", elapsed = " << report.elapsed.count() << " s"
+        << ", throughput = " << report.GetRequestsPerSecond() << " req/s"
+        << ", p50 = " << report.latency_p50.count() << " us"
+        << ", p99 = " << report.latency_p99.count() << " us"
+        << ", max = " << report.latency_max.count() << " us";
+    return out;
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include "query_protocol.h"
+#include <chrono>
+#include <iostream>
+
+struct LoadGeneratorConfig {
+    Endpoint endpoint;
+    std::vector<std::string> queries;
+    size_t connection_count = 1;
+    // Requests a connection keeps in flight before waiting for a response
+    size_t pipeline_depth = 1;
+    size_t request_count = 10000;
+};
+
+struct LoadReport {
+    size_t request_count = 0;
+    size_t error_count = 0;
+    std::chrono::duration<double> elapsed{};
+    std::chrono::microseconds latency_p50{};
+    std::chrono::microseconds latency_p99{};
+    std::chrono::microseconds latency_max{};
+
+    double GetRequestsPerSecond() const;
+};
+
+// Sends find requests cycling through the queries and measures the latency of each one
+LoadReport RunLoadGenerator(const LoadGeneratorConfig& config);
+
+std::ostream& operator<<(std::ostream& out, const LoadReport& report);
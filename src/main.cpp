@@ -1,4 +1,133 @@
+#include "corpus_loader.h"
+#include "load_generator.h"
+#include "query_server.h"
+#include <csignal>
+#include <fstream>
+using namespace std;
 
-int main() {
-	return 0;
-}
\ No newline at end of file
+namespace {
+
+QueryServer* running_server = nullptr;
+
+void StopServer(int) {
+    if (running_server) {
+        running_server->Stop();
+    }
+}
+
+void PrintUsage() {
+    cerr << "Usage:\n"
+        << "  search_server serve (--port N [--host H] | --unix PATH) [--corpus FILE [--format tsv|lines]] [--stop-words WORDS] [--batch N]\n"
+        << "  search_server bench (--port N [--host H] | --unix PATH) --queries FILE [--connections N] [--pipeline N] [--requests N]\n"
+        << "TSV corpus lines are <id>\\t<status>\\t<rating,rating,...>\\t<text>, query lines are plain queries.\n";
+}
+
+// Parses --name value pairs following the command
+map<string, string> ParseOptions(int argc, char* argv[]) {
+    map<string, string> options;
+    for (int i = 2; i < argc; i += 2) {
+        const string name = argv[i];
+        if (name.substr(0, 2) != "--"s || i + 1 == argc) {
+            throw invalid_argument("Invalid option "s + name);
+        }
+        options[name.substr(2)] = argv[i + 1];
+    }
+    return options;
+}
+
+Endpoint ParseEndpoint(const map<string, string>& options) {
+    Endpoint endpoint;
+    if (options.count("unix"s)) {
+        endpoint.unix_path = options.at("unix"s);
+    }
+    else if (options.count("port"s)) {
+        endpoint.port = static_cast<uint16_t>(stoi(options.at("port"s)));
+        if (options.count("host"s)) {
+            endpoint.host = options.at("host"s);
+        }
+    }
+    else {
+        throw invalid_argument("Either --port or --unix is required"s);
+    }
+    return endpoint;
+}
+
+size_t GetNumber(const map<string, string>& options, const string& name, size_t default_value) {
+    return options.count(name) ? stoul(options.at(name)) : default_value;
+}
+
+CorpusFormat ParseCorpusFormat(const map<string, string>& options) {
+    if (!options.count("format"s) || options.at("format"s) == "tsv"s) {
+        return CorpusFormat::TSV;
+    }
+    if (options.at("format"s) == "lines"s) {
+        return CorpusFormat::LINES;
+    }
+    throw invalid_argument("Unknown corpus format "s + options.at("format"s));
+}
+
+int Serve(const map<string, string>& options) {
+    SearchServer search_server(options.count("stop-words"s) ? options.at("stop-words"s) : ""s);
+    if (options.count("corpus"s)) {
+        cerr << "Loaded corpus: "s << LoadCorpus(search_server, options.at("corpus"s), ParseCorpusFormat(options)) << endl;
+    }
+
+    QueryServerConfig config;
+    config.endpoint = ParseEndpoint(options);
+    config.max_batch_size = GetNumber(options, "batch"s, config.max_batch_size);
+    QueryServer server(search_server, config);
+
+    running_server = &server;
+    signal(SIGINT, StopServer);
+    signal(SIGTERM, StopServer);
+    cerr << "Serving "s << search_server.GetDocumentCount() << " documents"s << endl;
+    server.Run();
+    running_server = nullptr;
+    return 0;
+}
+
+int Bench(const map<string, string>& options) {
+    LoadGeneratorConfig config;
+    config.endpoint = ParseEndpoint(options);
+    config.connection_count = GetNumber(options, "connections"s, config.connection_count);
+    config.pipeline_depth = GetNumber(options, "pipeline"s, config.pipeline_depth);
+    config.request_count = GetNumber(options, "requests"s, config.request_count);
+
+    if (!options.count("queries"s)) {
+        throw invalid_argument("--queries is required"s);
+    }
+    ifstream input(options.at("queries"s));
+    for (string line; getline(input, line);) {
+        if (!line.empty()) {
+            config.queries.push_back(move(line));
+        }
+    }
+
+    cout << RunLoadGenerator(config) << endl;
+    return 0;
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        PrintUsage();
+        return 1;
+    }
+    try {
+        const string command = argv[1];
+        const auto options = ParseOptions(argc, argv);
+        if (command == "serve"s) {
+            return Serve(options);
+        }
+        if (command == "bench"s) {
+            return Bench(options);
+        }
+        PrintUsage();
+        return 1;
+    }
+    catch (const exception& e) {
+        cerr << "Error: "s << e.what() << endl;
+        return 1;
+    }
+}
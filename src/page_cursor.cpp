@@ -0,0 +1,50 @@
+#include "page_cursor.h"
+#include <charconv>
+#include <cstdio>
+#include <cstdlib>
+#include <stdexcept>
+using namespace std;
+
+namespace {
+
+int ParseTokenInt(string_view text) {
+    int value = 0;
+    const auto [ptr, error] = from_chars(text.data(), text.data() + text.size(), value);
+    if (error != errc{} || ptr != text.data() + text.size()) {
+        throw invalid_argument("Invalid page token"s);
+    }
+    return value;
+}
+
+}
+
+PageCursor::PageCursor(const Document& document)
+    : relevance(document.relevance)
+    , rating(document.rating)
+    , document_id(document.id)
+{
+}
+
+string PageCursor::ToToken() const {
+    char buffer[64];
+    const int size = snprintf(buffer, sizeof(buffer), "%a:%d:%d", relevance, rating, document_id);
+    return string(buffer, size);
+}
+
+PageCursor PageCursor::FromToken(string_view token) {
+    const size_t first_colon = token.find(':');
+    const size_t second_colon = token.find(':', first_colon == token.npos ? token.npos : first_colon + 1);
+    if (second_colon == token.npos) {
+        throw invalid_argument("Invalid page token"s);
+    }
+    PageCursor cursor;
+    const string relevance_text(token.substr(0, first_colon));
+    char* relevance_end = nullptr;
+    cursor.relevance = strtod(relevance_text.c_str(), &relevance_end);
+    if (relevance_text.empty() || relevance_end != relevance_text.c_str() + relevance_text.size()) {
+        throw invalid_argument("Invalid page token"s);
+    }
+    cursor.rating = ParseTokenInt(token.substr(first_colon + 1, second_colon - first_colon - 1));
+    cursor.document_id = ParseTokenInt(token.substr(second_colon + 1));
+    return cursor;
+}
@@ -0,0 +1,27 @@
+#pragma once
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "document.h"
+
+// Position of the last document of a page in the result order
+// (relevance and rating descending, then document id ascending).
+struct PageCursor {
+    PageCursor() = default;
+    explicit PageCursor(const Document& document);
+
+    // Opaque text form that can be handed to clients and parsed back exactly
+    std::string ToToken() const;
+    static PageCursor FromToken(std::string_view token);
+
+    double relevance = 0.0;
+    int rating = 0;
+    int document_id = 0;
+};
+
+struct DocumentsPage {
+    std::vector<Document> documents;
+    // Set when documents remain after this page
+    std::optional<PageCursor> next_cursor;
+};
@@ -1,5 +1,8 @@
 #pragma once
 #include"document.h"
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
 using namespace std;
 
 template <typename Iterator>
@@ -28,34 +31,98 @@ private:
     size_t size_;
 };
 
+// Pages are computed while iterating, nothing is stored besides the bounds.
 template <typename Iterator>
 class Paginator {
 public:
-    Paginator(Iterator begin, Iterator end, size_t page_size) {
-        for (size_t left = distance(begin, end); left > 0;) {
-            const size_t current_page_size = min(page_size, left);
-            const Iterator current_page_end = next(begin, current_page_size);
-            pages_.push_back({ begin, current_page_end });
-
-            left -= current_page_size;
-            begin = current_page_end;
+    class PageIterator {
+    public:
+        using iterator_category = forward_iterator_tag;
+        using value_type = IteratorRange<Iterator>;
+        using difference_type = ptrdiff_t;
+        using pointer = const value_type*;
+        using reference = value_type;
+
+        PageIterator(Iterator page_begin, Iterator end, size_t page_size)
+            : page_begin_(page_begin)
+            , page_end_(AdvancePage(page_begin, end, page_size))
+            , end_(end)
+            , page_size_(page_size) {
+        }
+
+        IteratorRange<Iterator> operator*() const {
+            return { page_begin_, page_end_ };
+        }
+
+        PageIterator& operator++() {
+            page_begin_ = page_end_;
+            page_end_ = AdvancePage(page_begin_, end_, page_size_);
+            return *this;
+        }
+
+        PageIterator operator++(int) {
+            PageIterator previous = *this;
+            ++*this;
+            return previous;
+        }
+
+        bool operator==(const PageIterator& other) const {
+            return page_begin_ == other.page_begin_;
+        }
+
+        bool operator!=(const PageIterator& other) const {
+            return !(*this == other);
+        }
+
+    private:
+        Iterator page_begin_, page_end_, end_;
+        size_t page_size_;
+    };
+
+    Paginator(Iterator begin, Iterator end, size_t page_size)
+        : begin_(begin)
+        , end_(end)
+        , page_size_(page_size) {
+        if (page_size_ == 0) {
+            throw invalid_argument("Page size must be positive"s);
         }
     }
 
-    auto begin() const {
-        return pages_.begin();
+    PageIterator begin() const {
+        return { begin_, end_, page_size_ };
     }
 
-    auto end() const {
-        return pages_.end();
+    PageIterator end() const {
+        return { end_, end_, page_size_ };
     }
 
     size_t size() const {
-        return pages_.size();
+        return (static_cast<size_t>(distance(begin_, end_)) + page_size_ - 1) / page_size_;
+    }
+
+    // Constant time for random access iterators
+    IteratorRange<Iterator> GetPage(size_t page_index) const {
+        const size_t total = distance(begin_, end_);
+        const size_t page_offset = min(total, page_index * page_size_);
+        const Iterator page_begin = next(begin_, page_offset);
+        return { page_begin, next(page_begin, min(page_size_, total - page_offset)) };
     }
 
 private:
-    vector<IteratorRange<Iterator>> pages_;
+    Iterator begin_, end_;
+    size_t page_size_;
+
+    static Iterator AdvancePage(Iterator from, Iterator end, size_t page_size) {
+        if constexpr (is_base_of_v<random_access_iterator_tag, typename iterator_traits<Iterator>::iterator_category>) {
+            return next(from, min<ptrdiff_t>(page_size, distance(from, end)));
+        }
+        else {
+            for (size_t i = 0; i < page_size && from != end; ++i) {
+                ++from;
+            }
+            return from;
+        }
+    }
 };
 
 template <typename Container>
@@ -0,0 +1,116 @@
+#include "percolator.h"
+using namespace std;
+
+namespace {
+
+void EraseQueryId(map<string, vector<int>, less<>>& queries_by_term, const string& term, int query_id) {
+    auto it_term = queries_by_term.find(term);
+    if (it_term == queries_by_term.end()) {
+        return;
+    }
+    auto& query_ids = it_term->second;
+    query_ids.erase(remove(query_ids.begin(), query_ids.end(), query_id), query_ids.end());
+    if (query_ids.empty()) {
+        queries_by_term.erase(it_term);
+    }
+}
+
+}
+
+Percolator::Percolator(SearchServer& search_server, MatchHandler on_match)
+    : search_server_(search_server)
+    , on_match_(move(on_match))
+{
+    handler_id_ = search_server_.AddDocumentAddedHandler([this](int document_id, DocumentStatus status, int rating,
+        const SearchServer::WordFrequencies& word_frequencies) {
+            Percolate(document_id, status, word_frequencies);
+        });
+}
+
+Percolator::~Percolator() {
+    search_server_.RemoveDocumentAddedHandler(handler_id_);
+}
+
+int Percolator::RegisterQuery(string_view raw_query, DocumentStatus status) {
+    QueryTerms terms = search_server_.ParseQueryTerms(raw_query);
+    const int query_id = next_query_id_++;
+    for (const string& word : terms.plus_words) {
+        queries_by_word_[word].push_back(query_id);
+    }
+    for (const string& prefix : terms.plus_prefixes) {
+        queries_by_prefix_[prefix].push_back(query_id);
+        max_prefix_length_ = max(max_prefix_length_, prefix.size());
+    }
+    queries_.emplace(query_id, StandingQuery{ move(terms), status });
+    return query_id;
+}
+
+void Percolator::UnregisterQuery(int query_id) {
+    auto it_query = queries_.find(query_id);
+    if (it_query == queries_.end()) {
+        return;
+    }
+    for (const string& word : it_query->second.terms.plus_words) {
+        EraseQueryId(queries_by_word_, word, query_id);
+    }
+    for (const string& prefix : it_query->second.terms.plus_prefixes) {
+        EraseQueryId(queries_by_prefix_, prefix, query_id);
+    }
+    queries_.erase(it_query);
+}
+
+size_t Percolator::GetQueryCount() const {
+    return queries_.size();
+}
+
+vector<PercolatorMatch> Percolator::TakeMatches() {
+    vector<PercolatorMatch> matches(matches_.begin(), matches_.end());
+    matches_.clear();
+    return matches;
+}
+
+void Percolator::Percolate(int document_id, DocumentStatus status, const SearchServer::WordFrequencies& word_frequencies) {
+    vector<int> candidates;
+    const auto add_candidates = [&candidates](const auto& queries_by_term, string_view term) {
+        const auto it_term = queries_by_term.find(term);
+        if (it_term != queries_by_term.end()) {
+            candidates.insert(candidates.end(), it_term->second.begin(), it_term->second.end());
+        }
+    };
+    for (const auto& [word, _] : word_frequencies) {
+        add_candidates(queries_by_word_, word);
+        if (queries_by_prefix_.empty()) {
+            continue;
+        }
+        for (size_t length = 1; length <= min(word.size(), max_prefix_length_); ++length) {
+            add_candidates(queries_by_prefix_, word.substr(0, length));
+        }
+    }
+    sort(candidates.begin(), candidates.end());
+    candidates.erase(unique(candidates.begin(), candidates.end()), candidates.end());
+
+    for (const int query_id : candidates) {
+        const StandingQuery& query = queries_.at(query_id);
+        if (query.status != status) {
+            continue;
+        }
+        const bool has_minus_word = any_of(query.terms.minus_words.begin(), query.terms.minus_words.end(),
+            [&word_frequencies](const string& word) {
+                return word_frequencies.count(word) > 0;
+            })
+            || any_of(query.terms.minus_prefixes.begin(), query.terms.minus_prefixes.end(),
+                [&word_frequencies](const string& prefix) {
+                    return SearchServer::HasWordWithPrefix(word_frequencies, prefix);
+                });
+        if (has_minus_word) {
+            continue;
+        }
+        const PercolatorMatch match{ query_id, document_id };
+        if (on_match_) {
+            on_match_(match);
+        }
+        else {
+            matches_.push_back(match);
+        }
+    }
+}
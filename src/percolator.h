@@ -0,0 +1,51 @@
+#pragma once
+#include "search_server.h"
+#include <deque>
+
+struct PercolatorMatch {
+    int query_id = 0;
+    int document_id = 0;
+};
+
+// Standing queries checked against every document added to the search server.
+// A document matches a query when FindTopDocuments for that query could return it:
+// it has the query status, contains a plus word (or a word starting with a plus
+// prefix) and no minus word or minus prefix. Queries are indexed by each of their
+// plus words and prefixes, so the work per document depends on its own words and
+// on the queries sharing them, not on the total number of queries. Several
+// percolators may watch the same server; each must be destroyed before it.
+class Percolator {
+public:
+    using MatchHandler = std::function<void(const PercolatorMatch& match)>;
+
+    // Without a handler matches are queued until TakeMatches is called
+    explicit Percolator(SearchServer& search_server, MatchHandler on_match = nullptr);
+    ~Percolator();
+
+    Percolator(const Percolator&) = delete;
+    Percolator& operator=(const Percolator&) = delete;
+
+    int RegisterQuery(std::string_view raw_query, DocumentStatus status = DocumentStatus::ACTUAL);
+    void UnregisterQuery(int query_id);
+    size_t GetQueryCount() const;
+
+    std::vector<PercolatorMatch> TakeMatches();
+
+private:
+    struct StandingQuery {
+        QueryTerms terms;
+        DocumentStatus status;
+    };
+
+    SearchServer& search_server_;
+    MatchHandler on_match_;
+    int handler_id_ = 0;
+    std::map<int, StandingQuery> queries_;
+    std::map<std::string, std::vector<int>, std::less<>> queries_by_word_;
+    std::map<std::string, std::vector<int>, std::less<>> queries_by_prefix_;
+    size_t max_prefix_length_ = 0;
+    std::deque<PercolatorMatch> matches_;
+    int next_query_id_ = 0;
+
+    void Percolate(int document_id, DocumentStatus status, const SearchServer::WordFrequencies& word_frequencies);
+};
@@ -2,13 +2,7 @@
 std::vector<std::vector<Document>> ProcessQueries(
     const SearchServer& search_server,
     const std::vector<std::string>& queries) {
-    std::vector<std::vector<Document>> result(queries.size());
-    std::transform(std::execution::par, queries.begin(), queries.end(),
-        result.begin(),
-        [&search_server](const std::string_view query) {
-            return search_server.FindTopDocuments(std::execution::par_unseq,query);
-        });
-    return result;
+    return search_server.FindTopDocumentsBatch(queries);
 }
 
 std::list<Document> ProcessQueriesJoined(const SearchServer& search_server, const std::vector<std::string>& queries) {
@@ -0,0 +1,249 @@
+#include "query_protocol.h"
+#include <arpa/inet.h>
+#include <charconv>
+#include <cstring>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdexcept>
+#include <sstream>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <system_error>
+#include <unistd.h>
+using namespace std;
+
+namespace {
+
+const size_t FRAME_HEADER_SIZE = 4;
+
+int ParseInt(string_view text) {
+    int value = 0;
+    const auto [ptr, error] = from_chars(text.data(), text.data() + text.size(), value);
+    if (error != errc{} || ptr != text.data() + text.size()) {
+        throw invalid_argument("Invalid number in request"s);
+    }
+    return value;
+}
+
+// Splits off the text before the next tab and removes it with the tab from text
+string_view NextField(string_view& text) {
+    const size_t tab = text.find('\t');
+    if (tab == text.npos) {
+        throw invalid_argument("Missing request field"s);
+    }
+    const string_view field = text.substr(0, tab);
+    text.remove_prefix(tab + 1);
+    return field;
+}
+
+[[noreturn]] void ThrowSystemError(const char* what) {
+    throw system_error(errno, generic_category(), what);
+}
+
+sockaddr_un MakeUnixAddress(const string& path) {
+    sockaddr_un address{};
+    if (path.size() >= sizeof(address.sun_path)) {
+        throw invalid_argument("Unix socket path is too long"s);
+    }
+    address.sun_family = AF_UNIX;
+    memcpy(address.sun_path, path.c_str(), path.size() + 1);
+    return address;
+}
+
+// Removes a socket file left behind by a server that is gone. Anything else at the path,
+// including the socket of a running server, is kept and makes bind fail.
+void RemoveStaleSocket(const string& path) {
+    struct stat status;
+    if (lstat(path.c_str(), &status) < 0 || !S_ISSOCK(status.st_mode)) {
+        return;
+    }
+    const int probe_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (probe_fd < 0) {
+        ThrowSystemError("socket");
+    }
+    const sockaddr_un address = MakeUnixAddress(path);
+    const bool is_stale = connect(probe_fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) < 0
+        && errno == ECONNREFUSED;
+    close(probe_fd);
+    if (is_stale) {
+        unlink(path.c_str());
+    }
+}
+
+sockaddr_in MakeInetAddress(const Endpoint& endpoint) {
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(endpoint.port);
+    if (inet_pton(AF_INET, endpoint.host.c_str(), &address.sin_addr) != 1) {
+        throw invalid_argument("Invalid host "s + endpoint.host);
+    }
+    return address;
+}
+
+}
+
+void AppendFrame(string& out, string_view payload) {
+    const uint32_t size = static_cast<uint32_t>(payload.size());
+    out.push_back(static_cast<char>(size >> 24));
+    out.push_back(static_cast<char>(size >> 16));
+    out.push_back(static_cast<char>(size >> 8));
+    out.push_back(static_cast<char>(size));
+    out.append(payload);
+}
+
+optional<string_view> NextFrame(string_view buffer, size_t& offset) {
+    if (buffer.size() - offset < FRAME_HEADER_SIZE) {
+        return nullopt;
+    }
+    const auto* header = reinterpret_cast<const unsigned char*>(buffer.data() + offset);
+    const uint32_t size = (uint32_t{ header[0] } << 24) | (uint32_t{ header[1] } << 16)
+        | (uint32_t{ header[2] } << 8) | uint32_t{ header[3] };
+    if (size > MAX_FRAME_SIZE) {
+        throw invalid_argument("Frame is too large"s);
+    }
+    if (buffer.size() - offset - FRAME_HEADER_SIZE < size) {
+        return nullopt;
+    }
+    const string_view payload = buffer.substr(offset + FRAME_HEADER_SIZE, size);
+    offset += FRAME_HEADER_SIZE + size;
+    return payload;
+}
+
+string EncodeRequest(const QueryRequest& request) {
+    string payload(1, static_cast<char>(request.command));
+    if (request.command != QueryCommand::FIND) {
+        payload += to_string(request.document_id) + '\t';
+    }
+    if (request.command == QueryCommand::ADD) {
+        payload += to_string(static_cast<int>(request.status)) + '\t';
+        for (size_t i = 0; i < request.ratings.size(); ++i) {
+            if (i > 0) {
+                payload += ',';
+            }
+            payload += to_string(request.ratings[i]);
+        }
+        payload += '\t';
+    }
+    payload += request.text;
+    return payload;
+}
+
+QueryRequest DecodeRequest(string_view payload) {
+    if (payload.empty()) {
+        throw invalid_argument("Empty request"s);
+    }
+    QueryRequest request;
+    request.command = static_cast<QueryCommand>(payload[0]);
+    payload.remove_prefix(1);
+    switch (request.command) {
+    case QueryCommand::FIND:
+        break;
+    case QueryCommand::MATCH:
+        request.document_id = ParseInt(NextField(payload));
+        break;
+    case QueryCommand::ADD: {
+        request.document_id = ParseInt(NextField(payload));
+        const int status = ParseInt(NextField(payload));
+        if (status < static_cast<int>(DocumentStatus::ACTUAL) || status > static_cast<int>(DocumentStatus::REMOVED)) {
+            throw invalid_argument("Invalid document status"s);
+        }
+        request.status = static_cast<DocumentStatus>(status);
+        string_view ratings = NextField(payload);
+        while (!ratings.empty()) {
+            const size_t comma = ratings.find(',');
+            request.ratings.push_back(ParseInt(ratings.substr(0, comma)));
+            ratings.remove_prefix(comma == ratings.npos ? ratings.size() : comma + 1);
+        }
+        break;
+    }
+    default:
+        throw invalid_argument("Unknown request command"s);
+    }
+    request.text = string(payload);
+    return request;
+}
+
+string EncodeDocuments(const vector<Document>& documents) {
+    ostringstream out;
+    out.precision(17);
+    out << 'O';
+    for (const Document& document : documents) {
+        out << document.id << ' ' << document.relevance << ' ' << document.rating << '\n';
+    }
+    return out.str();
+}
+
+string EncodeMatch(const vector<string_view>& words, DocumentStatus status) {
+    string payload = "O"s + to_string(static_cast<int>(status));
+    for (const string_view word : words) {
+        payload += ' ';
+        payload += word;
+    }
+    return payload;
+}
+
+string EncodeOk() {
+    return "O"s;
+}
+
+string EncodeError(string_view message) {
+    return "E"s + string(message);
+}
+
+bool IsErrorResponse(string_view payload) {
+    return payload.empty() || payload[0] == 'E';
+}
+
+int ListenOn(const Endpoint& endpoint) {
+    const int domain = endpoint.unix_path.empty() ? AF_INET : AF_UNIX;
+    const int fd = socket(domain, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        ThrowSystemError("socket");
+    }
+    int result;
+    if (domain == AF_UNIX) {
+        const sockaddr_un address = MakeUnixAddress(endpoint.unix_path);
+        RemoveStaleSocket(endpoint.unix_path);
+        result = bind(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address));
+    }
+    else {
+        const int enable = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+        const sockaddr_in address = MakeInetAddress(endpoint);
+        result = bind(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address));
+    }
+    if (result < 0 || listen(fd, SOMAXCONN) < 0) {
+        const int error = errno;
+        close(fd);
+        errno = error;
+        ThrowSystemError("bind");
+    }
+    return fd;
+}
+
+int ConnectTo(const Endpoint& endpoint) {
+    const int domain = endpoint.unix_path.empty() ? AF_INET : AF_UNIX;
+    const int fd = socket(domain, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        ThrowSystemError("socket");
+    }
+    int result;
+    if (domain == AF_UNIX) {
+        const sockaddr_un address = MakeUnixAddress(endpoint.unix_path);
+        result = connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address));
+    }
+    else {
+        const sockaddr_in address = MakeInetAddress(endpoint);
+        result = connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address));
+        const int enable = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+    }
+    if (result < 0) {
+        const int error = errno;
+        close(fd);
+        errno = error;
+        ThrowSystemError("connect");
+    }
+    return fd;
+}
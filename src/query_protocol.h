@@ -0,0 +1,55 @@
+#pragma once
+#include "document.h"
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Every message is a frame: a 4-byte big-endian payload length followed by the payload.
+// A request payload starts with the command letter, its fields are separated by tabs:
+//   F<query>
+//   M<document_id>\t<query>
+//   A<document_id>\t<status>\t<rating,rating,...>\t<text>
+// A response payload starts with 'O' followed by the result or 'E' followed by the error.
+// Responses on a connection come in the order of its requests, so clients may pipeline.
+const uint32_t MAX_FRAME_SIZE = 16 * 1024 * 1024;
+
+enum class QueryCommand : char {
+    FIND = 'F',
+    MATCH = 'M',
+    ADD = 'A',
+};
+
+struct QueryRequest {
+    QueryCommand command = QueryCommand::FIND;
+    int document_id = 0;
+    DocumentStatus status = DocumentStatus::ACTUAL;
+    std::vector<int> ratings;
+    std::string text;
+};
+
+struct Endpoint {
+    std::string host = "127.0.0.1";
+    uint16_t port = 0;
+    // Used instead of host and port when not empty
+    std::string unix_path;
+};
+
+void AppendFrame(std::string& out, std::string_view payload);
+// Returns the payload of the complete frame starting at offset and moves offset past it
+std::optional<std::string_view> NextFrame(std::string_view buffer, size_t& offset);
+
+std::string EncodeRequest(const QueryRequest& request);
+QueryRequest DecodeRequest(std::string_view payload);
+
+std::string EncodeDocuments(const std::vector<Document>& documents);
+std::string EncodeMatch(const std::vector<std::string_view>& words, DocumentStatus status);
+std::string EncodeOk();
+std::string EncodeError(std::string_view message);
+bool IsErrorResponse(std::string_view payload);
+
+// Returns a nonblocking listening socket
+int ListenOn(const Endpoint& endpoint);
+// Returns a blocking connected socket
+int ConnectTo(const Endpoint& endpoint);
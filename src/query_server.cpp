@@ -0,0 +1,399 @@
+#include "query_server.h"
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <system_error>
+#include <unistd.h>
+using namespace std;
+
+namespace {
+
+const size_t READ_CHUNK_SIZE = 64 * 1024;
+const int MAX_EPOLL_EVENTS = 64;
+const auto ACCEPT_BACKOFF = chrono::milliseconds(100);
+
+[[noreturn]] void ThrowSystemError(const char* what) {
+    throw system_error(errno, generic_category(), what);
+}
+
+void WatchFd(int epoll_fd, int operation, int fd, uint32_t events) {
+    epoll_event event{};
+    event.events = events;
+    event.data.fd = fd;
+    if (epoll_ctl(epoll_fd, operation, fd, &event) < 0) {
+        ThrowSystemError("epoll_ctl");
+    }
+}
+
+}
+
+QueryServer::QueryServer(SearchServer& search_server, const QueryServerConfig& config)
+    : search_server_(search_server)
+    , config_(config)
+{
+    if (config_.max_batch_size == 0) {
+        throw invalid_argument("Batch size must be positive"s);
+    }
+    try {
+        listen_fd_ = ListenOn(config_.endpoint);
+        if (!config_.endpoint.unix_path.empty()) {
+            struct stat status;
+            if (lstat(config_.endpoint.unix_path.c_str(), &status) == 0) {
+                bound_socket_file_.emplace(status.st_dev, status.st_ino);
+            }
+        }
+        wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (wake_fd_ < 0) {
+            ThrowSystemError("eventfd");
+        }
+        epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+        if (epoll_fd_ < 0) {
+            ThrowSystemError("epoll_create1");
+        }
+        WatchFd(epoll_fd_, EPOLL_CTL_ADD, listen_fd_, EPOLLIN);
+        WatchFd(epoll_fd_, EPOLL_CTL_ADD, wake_fd_, EPOLLIN);
+    }
+    catch (...) {
+        CloseAll();
+        throw;
+    }
+}
+
+QueryServer::~QueryServer() {
+    CloseAll();
+}
+
+void QueryServer::CloseAll() {
+    for (const auto& [fd, _] : connections_) {
+        close(fd);
+    }
+    connections_.clear();
+    for (int fd : { listen_fd_, wake_fd_, epoll_fd_ }) {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+    listen_fd_ = wake_fd_ = epoll_fd_ = -1;
+    // Another server may have replaced the socket file since, so only our own is removed
+    struct stat status;
+    if (bound_socket_file_ && lstat(config_.endpoint.unix_path.c_str(), &status) == 0 && S_ISSOCK(status.st_mode)
+        && bound_socket_file_ == pair<uint64_t, uint64_t>(status.st_dev, status.st_ino)) {
+        unlink(config_.endpoint.unix_path.c_str());
+    }
+    bound_socket_file_.reset();
+}
+
+void QueryServer::Run() {
+    vector<epoll_event> events(MAX_EPOLL_EVENTS);
+    vector<int> active_fds;
+    while (!stopped_) {
+        const int ready = epoll_wait(epoll_fd_, events.data(), MAX_EPOLL_EVENTS, GetEpollTimeout());
+        if (ready < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            ThrowSystemError("epoll_wait");
+        }
+        ResumeAcceptingIfDue();
+
+        active_fds.clear();
+        for (int i = 0; i < ready; ++i) {
+            const int fd = events[i].data.fd;
+            if (fd == listen_fd_) {
+                AcceptConnections();
+                continue;
+            }
+            if (fd == wake_fd_) {
+                stopped_ = true;
+                continue;
+            }
+            auto it_connection = connections_.find(fd);
+            if (it_connection == connections_.end()) {
+                continue;
+            }
+            Connection& connection = it_connection->second;
+            const uint32_t flags = events[i].events;
+            if ((flags & (EPOLLIN | EPOLLHUP | EPOLLERR)) && !ReadFromConnection(fd, connection)) {
+                CloseConnection(fd);
+                continue;
+            }
+            // Pending responses are flushed by UpdateConnection below
+            active_fds.push_back(fd);
+        }
+
+        auto batch = CollectBatch();
+        ExecuteBatch(batch);
+        for (PendingRequest& pending : batch) {
+            AppendFrame(connections_.at(pending.fd).output, pending.response);
+            active_fds.push_back(pending.fd);
+        }
+
+        sort(active_fds.begin(), active_fds.end());
+        active_fds.erase(unique(active_fds.begin(), active_fds.end()), active_fds.end());
+        for (const int fd : active_fds) {
+            auto it_connection = connections_.find(fd);
+            if (it_connection != connections_.end()) {
+                UpdateConnection(fd, it_connection->second);
+            }
+        }
+    }
+}
+
+int QueryServer::GetEpollTimeout() const {
+    if (has_buffered_requests_) {
+        return 0;
+    }
+    if (!accept_resume_time_) {
+        return -1;
+    }
+    const auto delay = chrono::ceil<chrono::milliseconds>(*accept_resume_time_ - chrono::steady_clock::now());
+    return static_cast<int>(max<chrono::milliseconds::rep>(delay.count(), 0));
+}
+
+void QueryServer::Stop() {
+    const uint64_t one = 1;
+    [[maybe_unused]] const auto written = write(wake_fd_, &one, sizeof(one));
+}
+
+void QueryServer::AcceptConnections() {
+    while (!accept_resume_time_) {
+        const int fd = accept4(listen_fd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return;
+            }
+            // Running out of descriptors or memory must not stop the server:
+            // the pending connections wait in the backlog until accepting resumes
+            cerr << "accept4: "s << strerror(errno) << endl;
+            PauseAccepting();
+            return;
+        }
+        if (config_.endpoint.unix_path.empty()) {
+            const int enable = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+        }
+        const auto it_connection = connections_.emplace(fd, Connection{}).first;
+        try {
+            WatchFd(epoll_fd_, EPOLL_CTL_ADD, fd, EPOLLIN);
+            it_connection->second.watched_events = EPOLLIN;
+        }
+        catch (const system_error& e) {
+            cerr << e.what() << endl;
+            connections_.erase(it_connection);
+            close(fd);
+            PauseAccepting();
+            return;
+        }
+    }
+}
+
+void QueryServer::PauseAccepting() {
+    WatchFd(epoll_fd_, EPOLL_CTL_MOD, listen_fd_, 0);
+    accept_resume_time_ = chrono::steady_clock::now() + ACCEPT_BACKOFF;
+}
+
+void QueryServer::ResumeAcceptingIfDue() {
+    if (accept_resume_time_ && chrono::steady_clock::now() >= *accept_resume_time_) {
+        WatchFd(epoll_fd_, EPOLL_CTL_MOD, listen_fd_, EPOLLIN);
+        accept_resume_time_.reset();
+    }
+}
+
+bool QueryServer::ReadFromConnection(int fd, Connection& connection) {
+    char buffer[READ_CHUNK_SIZE];
+    // The rest stays in the socket: epoll keeps reporting it once reading resumes
+    while (!connection.is_read_closed && !IsInputFull(connection)) {
+        const ssize_t received = read(fd, buffer, sizeof(buffer));
+        if (received > 0) {
+            connection.input.append(buffer, received);
+            continue;
+        }
+        if (received == 0) {
+            connection.is_read_closed = true;
+            break;
+        }
+        if (errno == EINTR) {
+            continue;
+        }
+        return errno == EAGAIN || errno == EWOULDBLOCK;
+    }
+    return true;
+}
+
+bool QueryServer::FlushConnection(int fd, Connection& connection) {
+    while (connection.output_offset < connection.output.size()) {
+        const ssize_t sent = send(fd, connection.output.data() + connection.output_offset,
+            connection.output.size() - connection.output_offset, MSG_NOSIGNAL);
+        if (sent >= 0) {
+            connection.output_offset += sent;
+            continue;
+        }
+        if (errno == EINTR) {
+            continue;
+        }
+        return errno == EAGAIN || errno == EWOULDBLOCK;
+    }
+    connection.output.clear();
+    connection.output_offset = 0;
+    return true;
+}
+
+// Sends what the socket accepts, closes the connection when the peer has shut down
+// its side and nothing is left to answer, otherwise watches the events it now needs
+void QueryServer::UpdateConnection(int fd, Connection& connection) {
+    if (!FlushConnection(fd, connection)) {
+        CloseConnection(fd);
+        return;
+    }
+    const bool has_complete_request = HasCompleteRequest(connection);
+    if (connection.is_read_closed && connection.output.empty() && !has_complete_request) {
+        CloseConnection(fd);
+        return;
+    }
+    // CollectBatch skipped this connection while its output was full; its requests
+    // may already be buffered, so epoll must not block waiting for more input
+    if (has_complete_request && !IsOutputFull(connection)) {
+        has_buffered_requests_ = true;
+    }
+    uint32_t events = 0;
+    if (!connection.is_read_closed && !IsInputFull(connection) && !IsOutputFull(connection)) {
+        events |= EPOLLIN;
+    }
+    if (!connection.output.empty()) {
+        events |= EPOLLOUT;
+    }
+    if (events != connection.watched_events) {
+        WatchFd(epoll_fd_, EPOLL_CTL_MOD, fd, events);
+        connection.watched_events = events;
+    }
+}
+
+void QueryServer::CloseConnection(int fd) {
+    epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+    close(fd);
+    connections_.erase(fd);
+}
+
+bool QueryServer::HasCompleteRequest(const Connection& connection) const {
+    size_t offset = connection.input_offset;
+    try {
+        return NextFrame(connection.input, offset).has_value();
+    }
+    catch (const invalid_argument&) {
+        // Malformed input is reported by CollectBatch
+        return true;
+    }
+}
+
+bool QueryServer::IsInputFull(const Connection& connection) const {
+    return connection.input.size() - connection.input_offset >= config_.max_input_buffer_size
+        && HasCompleteRequest(connection);
+}
+
+bool QueryServer::IsOutputFull(const Connection& connection) const {
+    return connection.output.size() - connection.output_offset >= config_.max_output_buffer_size;
+}
+
+vector<QueryServer::PendingRequest> QueryServer::CollectBatch() {
+    vector<PendingRequest> batch;
+    vector<int> broken_connections;
+    // Takes one request per connection per pass so that a busy client cannot fill the whole batch
+    bool found_request = true;
+    while (found_request && batch.size() < config_.max_batch_size) {
+        found_request = false;
+        for (auto& [fd, connection] : connections_) {
+            if (batch.size() == config_.max_batch_size) {
+                break;
+            }
+            if (IsOutputFull(connection)) {
+                continue;
+            }
+            optional<string_view> payload;
+            try {
+                payload = NextFrame(connection.input, connection.input_offset);
+            }
+            catch (const invalid_argument&) {
+                broken_connections.push_back(fd);
+                connection.input.clear();
+                connection.input_offset = 0;
+                continue;
+            }
+            if (!payload) {
+                continue;
+            }
+            found_request = true;
+            PendingRequest pending{ fd, nullopt, {} };
+            try {
+                pending.request = DecodeRequest(*payload);
+            }
+            catch (const invalid_argument& e) {
+                pending.response = EncodeError(e.what());
+            }
+            batch.push_back(move(pending));
+        }
+    }
+    has_buffered_requests_ = found_request;
+
+    for (auto& [_, connection] : connections_) {
+        connection.input.erase(0, connection.input_offset);
+        connection.input_offset = 0;
+    }
+    for (const int fd : broken_connections) {
+        CloseConnection(fd);
+    }
+    batch.erase(remove_if(batch.begin(), batch.end(), [this](const PendingRequest& pending) {
+        return connections_.count(pending.fd) == 0;
+        }), batch.end());
+    return batch;
+}
+
+void QueryServer::ExecuteBatch(vector<PendingRequest>& batch) {
+    const auto is_write = [](const PendingRequest& pending) {
+        return pending.request && pending.request->command == QueryCommand::ADD;
+    };
+    const auto execute = [this](PendingRequest& pending) {
+        if (pending.request) {
+            pending.response = Execute(*pending.request);
+        }
+    };
+
+    auto segment_begin = batch.begin();
+    while (segment_begin != batch.end()) {
+        auto segment_end = find_if(segment_begin, batch.end(), is_write);
+        for_each(execution::par, segment_begin, segment_end, execute);
+        if (segment_end != batch.end()) {
+            execute(*segment_end);
+            ++segment_end;
+        }
+        segment_begin = segment_end;
+    }
+}
+
+string QueryServer::Execute(const QueryRequest& request) {
+    try {
+        switch (request.command) {
+        case QueryCommand::FIND:
+            return EncodeDocuments(search_server_.FindTopDocuments(request.text));
+        case QueryCommand::MATCH: {
+            const auto [words, status] = search_server_.MatchDocument(request.text, request.document_id);
+            return EncodeMatch(words, status);
+        }
+        case QueryCommand::ADD:
+            search_server_.AddDocument(request.document_id, request.text, request.status, request.ratings);
+            return EncodeOk();
+        }
+    }
+    catch (const exception& e) {
+        return EncodeError(e.what());
+    }
+    return EncodeError("Unknown request command"s);
+}
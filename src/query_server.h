@@ -0,0 +1,83 @@
+#pragma once
+#include "query_protocol.h"
+#include "search_server.h"
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <optional>
+
+struct QueryServerConfig {
+    Endpoint endpoint;
+    // Upper bound on requests executed together in one event loop iteration
+    size_t max_batch_size = 256;
+    // Reading from a connection pauses while it holds more unprocessed requests than this.
+    // A single larger request is still read in full.
+    size_t max_input_buffer_size = 1024 * 1024;
+    // Reading from a connection pauses while more of its responses than this wait to be sent
+    size_t max_output_buffer_size = 4 * 1024 * 1024;
+};
+
+// Serves a SearchServer over the frame protocol from query_protocol.h with a
+// single epoll event loop. All complete requests read in one loop iteration form
+// a micro-batch: runs of reads execute in parallel like ProcessQueries does,
+// additions execute one at a time in arrival order. A connection whose peer has
+// shut down its side is closed once its buffered requests are answered.
+class QueryServer {
+public:
+    QueryServer(SearchServer& search_server, const QueryServerConfig& config);
+    ~QueryServer();
+
+    QueryServer(const QueryServer&) = delete;
+    QueryServer& operator=(const QueryServer&) = delete;
+
+    // Serves connections until Stop is called
+    void Run();
+    // Safe to call from other threads and from signal handlers
+    void Stop();
+
+private:
+    struct Connection {
+        std::string input;
+        size_t input_offset = 0;
+        std::string output;
+        size_t output_offset = 0;
+        uint32_t watched_events = 0;
+        bool is_read_closed = false;
+    };
+
+    struct PendingRequest {
+        int fd;
+        std::optional<QueryRequest> request;
+        std::string response;
+    };
+
+    SearchServer& search_server_;
+    const QueryServerConfig config_;
+    int listen_fd_ = -1;
+    int wake_fd_ = -1;
+    int epoll_fd_ = -1;
+    std::atomic_bool stopped_ = false;
+    // Device and inode of the Unix socket file this server bound
+    std::optional<std::pair<uint64_t, uint64_t>> bound_socket_file_;
+    std::map<int, Connection> connections_;
+    // Set when the last batch was full and some connections still have complete requests
+    bool has_buffered_requests_ = false;
+    // Set while accepting is paused after accept4 failed, e.g. for lack of file descriptors
+    std::optional<std::chrono::steady_clock::time_point> accept_resume_time_;
+
+    void CloseAll();
+    int GetEpollTimeout() const;
+    void AcceptConnections();
+    void PauseAccepting();
+    void ResumeAcceptingIfDue();
+    bool ReadFromConnection(int fd, Connection& connection);
+    bool FlushConnection(int fd, Connection& connection);
+    void UpdateConnection(int fd, Connection& connection);
+    void CloseConnection(int fd);
+    bool HasCompleteRequest(const Connection& connection) const;
+    bool IsInputFull(const Connection& connection) const;
+    bool IsOutputFull(const Connection& connection) const;
+    std::vector<PendingRequest> CollectBatch();
+    void ExecuteBatch(std::vector<PendingRequest>& batch);
+    std::string Execute(const QueryRequest& request);
+};
@@ -0,0 +1,31 @@
+#include "search_limits.h"
+using namespace std;
+
+CancellationToken::CancellationToken()
+    : cancelled_(make_shared<atomic_bool>(false))
+{
+}
+
+void CancellationToken::Cancel() const {
+    cancelled_->store(true, memory_order_relaxed);
+}
+
+bool CancellationToken::IsCancelled() const {
+    return cancelled_->load(memory_order_relaxed);
+}
+
+SearchLimits::SearchLimits(Clock::duration timeout, CancellationToken cancellation)
+    : deadline(Clock::now() + timeout)
+    , cancellation(move(cancellation))
+{
+}
+
+SearchLimits::SearchLimits(Clock::time_point deadline, CancellationToken cancellation)
+    : deadline(deadline)
+    , cancellation(move(cancellation))
+{
+}
+
+bool SearchLimits::IsExceeded() const {
+    return cancellation.IsCancelled() || Clock::now() >= deadline;
+}
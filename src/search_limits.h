@@ -0,0 +1,35 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <vector>
+#include "document.h"
+
+class CancellationToken {
+public:
+    CancellationToken();
+
+    void Cancel() const;
+    bool IsCancelled() const;
+
+private:
+    std::shared_ptr<std::atomic_bool> cancelled_;
+};
+
+struct SearchLimits {
+    using Clock = std::chrono::steady_clock;
+
+    SearchLimits() = default;
+    explicit SearchLimits(Clock::duration timeout, CancellationToken cancellation = {});
+    explicit SearchLimits(Clock::time_point deadline, CancellationToken cancellation = {});
+
+    bool IsExceeded() const;
+
+    Clock::time_point deadline = Clock::time_point::max();
+    CancellationToken cancellation;
+};
+
+struct SearchResult {
+    std::vector<Document> documents;
+    bool is_partial = false;
+};
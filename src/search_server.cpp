@@ -21,19 +21,90 @@ void SearchServer::AddDocument(int document_id, const string_view& document, Doc
     const auto words = SplitIntoWordsNoStopView(document);
 
     const double inv_word_count = 1.0 / words.size();
+    auto& word_freqs = document_to_word_freqs_[document_id];
     for (const string_view word : words) {
-        string_words_.emplace(word);
-        word_to_document_freqs_[*string_words_.find(word)][document_id] += inv_word_count;
-        document_to_word_freqs_[document_id][*string_words_.find(word)] += inv_word_count;
+        const uint32_t word_id = words_.Insert(word);
+        if (word_id == word_postings_.size()) {
+            word_postings_.emplace_back();
+        }
+        word_postings_[word_id][document_id] += inv_word_count;
+        word_freqs[words_.GetTerm(word_id)] += inv_word_count;
     }
-    SearchServer::documents_.emplace(document_id, DocumentData{ ComputeAverageRating(ratings), status });
+    const auto& [_, document_data] = *SearchServer::documents_.emplace(document_id, DocumentData{ ComputeAverageRating(ratings), status }).first;
     document_ids_.emplace(document_id);
+    UpdateDocumentRanges();
+    exception_ptr handler_error;
+    for (const auto& [_, handler] : document_added_handlers_) {
+        try {
+            handler(document_id, status, document_data.rating, word_freqs);
+        }
+        catch (...) {
+            if (!handler_error) {
+                handler_error = current_exception();
+            }
+        }
+    }
+    if (handler_error) {
+        rethrow_exception(handler_error);
+    }
+}
+
+int SearchServer::AddDocumentAddedHandler(DocumentAddedHandler handler) {
+    if (!handler) {
+        throw invalid_argument("Document added handler is empty"s);
+    }
+    const int handler_id = next_document_added_handler_id_++;
+    document_added_handlers_.emplace(handler_id, move(handler));
+    return handler_id;
+}
+
+void SearchServer::RemoveDocumentAddedHandler(int handler_id) {
+    document_added_handlers_.erase(handler_id);
 }
 
 int SearchServer::GetDocumentCount() const{
     return documents_.size();
 }
 
+QueryTerms SearchServer::ParseQueryTerms(string_view raw_query) const {
+    set<string_view> plus_words;
+    set<string_view> minus_words;
+    set<string_view> plus_prefixes;
+    set<string_view> minus_prefixes;
+    for (const string_view word : SplitIntoWordsView(raw_query)) {
+        const auto query_word = ParseQueryWordView(word);
+        if (query_word.is_stop) {
+            continue;
+        }
+        if (query_word.is_minus) {
+            (query_word.is_prefix ? minus_prefixes : minus_words).insert(query_word.data);
+        }
+        else {
+            (query_word.is_prefix ? plus_prefixes : plus_words).insert(query_word.data);
+        }
+    }
+    const auto to_strings = [](const set<string_view>& words) {
+        return vector<string>(words.begin(), words.end());
+    };
+    return { to_strings(plus_words), to_strings(minus_words), to_strings(plus_prefixes), to_strings(minus_prefixes) };
+}
+
+void SearchServer::CollectCorpusStatistics(string_view raw_query, CorpusStatistics& statistics) const {
+    const auto query = ParseQuery(raw_query);
+    statistics.document_count += GetDocumentCount();
+    for (const string_view word : query.plus_words) {
+        const auto* postings = FindWordPostings(word);
+        if (!postings || postings->empty()) {
+            continue;
+        }
+        auto it_count = statistics.word_document_counts.find(word);
+        if (it_count == statistics.word_document_counts.end()) {
+            it_count = statistics.word_document_counts.emplace(string(word), 0).first;
+        }
+        it_count->second += postings->size();
+    }
+}
+
 
 std::vector<Document> SearchServer::FindTopDocuments(const std::string_view& raw_query) const {
     return FindTopDocuments(raw_query, DocumentStatus::ACTUAL);
@@ -44,6 +115,34 @@ std::vector<Document> SearchServer::FindTopDocuments(const std::string_view& raw
         });
 }
 
+SearchResult SearchServer::FindTopDocuments(string_view raw_query, const SearchLimits& limits) const {
+    return FindTopDocuments(raw_query, limits, DocumentStatus::ACTUAL);
+}
+
+SearchResult SearchServer::FindTopDocuments(string_view raw_query, const SearchLimits& limits, DocumentStatus status) const {
+    return FindTopDocuments(raw_query, limits, [status](int document_id, DocumentStatus document_status, int rating) {
+        return document_status == status;
+        });
+}
+
+vector<vector<Document>> SearchServer::FindTopDocumentsBatch(const vector<string>& raw_queries) const {
+    return FindTopDocumentsBatch(raw_queries, [](int document_id, DocumentStatus document_status, int rating) {
+        return document_status == DocumentStatus::ACTUAL;
+        });
+}
+
+DocumentsPage SearchServer::FindDocumentsPage(string_view raw_query, size_t offset, size_t limit) const {
+    return FindDocumentsPage(execution::seq, raw_query, offset, limit, [](int document_id, DocumentStatus document_status, int rating) {
+        return document_status == DocumentStatus::ACTUAL;
+        });
+}
+
+DocumentsPage SearchServer::FindDocumentsPage(string_view raw_query, const PageCursor& after, size_t limit) const {
+    return FindDocumentsPage(execution::seq, raw_query, after, limit, [](int document_id, DocumentStatus document_status, int rating) {
+        return document_status == DocumentStatus::ACTUAL;
+        });
+}
+
 tuple<vector<string_view>, DocumentStatus> SearchServer::MatchDocument(const string_view& raw_query, int document_id)const {
     return MatchDocument(std::execution::seq,raw_query, document_id);
 }
@@ -51,29 +150,91 @@ tuple<vector<string_view>, DocumentStatus> SearchServer::MatchDocument(const str
 void SearchServer::RemoveDocument(int document_id) {
     return RemoveDocument(std::execution::seq, document_id);
 }
-const map<string_view, double>& SearchServer::GetWordFrequencies(int document_id) const
+const SearchServer::WordFrequencies& SearchServer::GetWordFrequencies(int document_id) const
 {
-    static map<string_view, double> empty;
+    static const WordFrequencies empty;
     return document_to_word_freqs_.count(document_id) ? document_to_word_freqs_.at(document_id) : empty;
 }
 
-std::set<int>::const_iterator SearchServer::begin() const
+bool SearchServer::HasWordWithPrefix(const WordFrequencies& word_frequencies, string_view prefix) {
+    const auto it_word = word_frequencies.lower_bound(prefix);
+    return it_word != word_frequencies.end() && it_word->first.substr(0, prefix.size()) == prefix;
+}
+
+std::pmr::set<int>::const_iterator SearchServer::begin() const
 {
     return document_ids_.begin();
 }
 
-std::set<int>::const_iterator SearchServer::end() const
+std::pmr::set<int>::const_iterator SearchServer::end() const
 {
     return document_ids_.end();
 }
 
+IndexMemoryStats SearchServer::GetMemoryStats() const {
+    IndexMemoryStats stats;
+    stats.dictionary = { dictionary_memory_->GetBytesInUse(), dictionary_memory_->GetBytesReserved(), words_.size() };
+    stats.postings = { postings_memory_->GetBytesInUse(), postings_memory_->GetBytesReserved(), 0 };
+    for (const Postings& postings : word_postings_) {
+        stats.postings.entry_count += postings.size();
+    }
+    stats.forward_index = { forward_index_memory_->GetBytesInUse(), forward_index_memory_->GetBytesReserved(), 0 };
+    for (const auto& [_, word_freqs] : document_to_word_freqs_) {
+        stats.forward_index.entry_count += word_freqs.size();
+    }
+    stats.metadata = { metadata_memory_->GetBytesInUse(), metadata_memory_->GetBytesReserved(), documents_.size() };
+    return stats;
+}
+
+void SearchServer::SetMemoryBudget(size_t bytes) {
+    memory_budget_ = bytes;
+    CompactIfOverBudget();
+}
+
+void SearchServer::CompactMemory() {
+    vector<vector<pair<int, double>>> word_postings(word_postings_.size());
+    for (size_t word_id = 0; word_id < word_postings_.size(); ++word_id) {
+        word_postings[word_id].assign(word_postings_[word_id].begin(), word_postings_[word_id].end());
+    }
+    vector<pair<int, vector<pair<string_view, double>>>> document_to_word_freqs;
+    document_to_word_freqs.reserve(document_to_word_freqs_.size());
+    for (const auto& [document_id, word_freqs] : document_to_word_freqs_) {
+        document_to_word_freqs.emplace_back(document_id, vector<pair<string_view, double>>(word_freqs.begin(), word_freqs.end()));
+    }
+    const vector<pair<int, DocumentData>> documents(documents_.begin(), documents_.end());
+
+    // Release requires the containers to hold no memory from the pools
+    word_postings_.clear();
+    word_postings_.shrink_to_fit();
+    document_to_word_freqs_.clear();
+    documents_.clear();
+    document_ids_.clear();
+    postings_memory_->Release();
+    forward_index_memory_->Release();
+    metadata_memory_->Release();
+
+    word_postings_.reserve(word_postings.size());
+    for (const auto& postings : word_postings) {
+        word_postings_.emplace_back(postings.begin(), postings.end());
+    }
+    for (const auto& [document_id, word_freqs] : document_to_word_freqs) {
+        document_to_word_freqs_[document_id].insert(word_freqs.begin(), word_freqs.end());
+    }
+    for (const auto& [document_id, document_data] : documents) {
+        documents_.emplace_hint(documents_.end(), document_id, document_data);
+        document_ids_.emplace_hint(document_ids_.end(), document_id);
+    }
+    words_.Compact();
+    removals_since_compaction_ = 0;
+}
+
 //private
 bool SearchServer::IsStopWord(const string& word)const{
     return stop_words_.count(word);
 }
 
 bool SearchServer::IsStopWordView(const string_view word)const {
-    return stop_words_.count(string(word));
+    return stop_words_.count(word);
 }
 
 bool SearchServer::IsValidWord(const string_view word){
@@ -141,10 +302,15 @@ SearchServer::QueryWord SearchServer::ParseQueryWordView(string_view text) const
         text = text.substr(1);
         is_minus = true;
     }
+    bool is_prefix = false;
+    if (text.size() > 1 && text.back() == '*') {
+        text.remove_suffix(1);
+        is_prefix = true;
+    }
     if ((text.empty() || text[0] == '-' || !IsValidWord(text))) {
         throw invalid_argument("Query word "s);
     }
-    return { text, is_minus, IsStopWordView(text) };
+    return { text, is_minus, !is_prefix && IsStopWordView(text), is_prefix };
 }
 
 SearchServer::Query SearchServer::ParseQuery(std::string_view text) const {
@@ -153,24 +319,152 @@ SearchServer::Query SearchServer::ParseQuery(std::string_view text) const {
 
     std::set<std::string_view> plus_words;
     std::set<std::string_view> minus_words;
+    std::set<std::string_view> minus_prefixes;
 
     for (auto word : words) {
         const auto query_word = ParseQueryWordView(word);
-        if (!query_word.is_stop) {
-            if (query_word.is_minus) {
-                minus_words.insert(move(query_word.data));
-            }
-            else {
-                plus_words.insert(move(query_word.data));
-            }
+        if (query_word.is_stop) {
+            continue;
+        }
+        if (!query_word.is_prefix) {
+            (query_word.is_minus ? minus_words : plus_words).insert(query_word.data);
+            continue;
+        }
+        // Truncating a minus prefix would let excluded documents through, so it is never expanded
+        if (query_word.is_minus) {
+            minus_prefixes.insert(query_word.data);
+            continue;
+        }
+        // Words left without documents by RemoveDocument do not use up the expansion
+        const auto has_documents = [this](uint32_t word_id) {
+            return !word_postings_[word_id].empty();
+        };
+        for (const uint32_t word_id : words_.FindByPrefix(query_word.data, MAX_PREFIX_EXPANSION, has_documents)) {
+            plus_words.insert(words_.GetTerm(word_id));
         }
     }
     return { std::vector<std::string_view>(plus_words.begin(), plus_words.end()),
-        std::vector<std::string_view>(minus_words.begin(), minus_words.end()) };
+        std::vector<std::string_view>(minus_words.begin(), minus_words.end()),
+        std::vector<std::string_view>(minus_prefixes.begin(), minus_prefixes.end()) };
 }
 
-double SearchServer::ComputeWordInverseDocumentFreq(const string& word) const {
-    return log(GetDocumentCount() * 1.0 / word_to_document_freqs_.at(word).size());
+const SearchServer::Postings* SearchServer::FindWordPostings(string_view word) const {
+    const auto word_id = words_.Find(word);
+    return word_id ? &word_postings_[*word_id] : nullptr;
+}
+
+bool SearchServer::HasWordWithAnyPrefix(int document_id, const vector<string_view>& prefixes) const {
+    if (prefixes.empty()) {
+        return false;
+    }
+    const auto& word_freqs = document_to_word_freqs_.at(document_id);
+    return any_of(prefixes.begin(), prefixes.end(), [&word_freqs](string_view prefix) {
+        return HasWordWithPrefix(word_freqs, prefix);
+        });
+}
+
+void SearchServer::CompactIfOverBudget() {
+    // Removals are what free pool memory; additions only leave the slack of pool growth,
+    // which a rebuild would not return
+    if (memory_budget_ == 0 || removals_since_compaction_ * 4 < documents_.size()) {
+        return;
+    }
+    const size_t compactable_in_use = postings_memory_->GetBytesInUse() + forward_index_memory_->GetBytesInUse()
+        + metadata_memory_->GetBytesInUse();
+    const size_t compactable_reserved = postings_memory_->GetBytesReserved() + forward_index_memory_->GetBytesReserved()
+        + metadata_memory_->GetBytesReserved();
+    const size_t total_reserved = compactable_reserved + dictionary_memory_->GetBytesReserved();
+    if (total_reserved > memory_budget_ && compactable_reserved - compactable_in_use > compactable_reserved / 4) {
+        CompactMemory();
+    }
+}
+
+vector<pair<int64_t, int64_t>> SearchServer::SplitDocumentIds() const {
+    if (document_ids_.empty()) {
+        return {};
+    }
+    vector<pair<int64_t, int64_t>> id_ranges;
+    id_ranges.reserve(range_boundaries_.size() + 1);
+    int64_t first_id = numeric_limits<int>::min();
+    for (const int boundary : range_boundaries_) {
+        id_ranges.emplace_back(first_id, boundary);
+        first_id = boundary;
+    }
+    id_ranges.emplace_back(first_id, static_cast<int64_t>(numeric_limits<int>::max()) + 1);
+    return id_ranges;
+}
+
+void SearchServer::UpdateDocumentRanges() {
+    // hardware_concurrency asks the kernel, too slow for every write
+    static const size_t max_range_count = max(1u, thread::hardware_concurrency()) * 4;
+    const size_t range_count = clamp<size_t>(document_ids_.size() / MIN_DOCUMENTS_PER_RANGE, 1, max_range_count);
+    ++writes_since_range_split_;
+    if (range_count == range_boundaries_.size() + 1 && writes_since_range_split_ <= document_ids_.size() / (2 * range_count)) {
+        return;
+    }
+
+    range_boundaries_.clear();
+    size_t position = 0;
+    auto it_id = document_ids_.begin();
+    for (size_t i = 1; i < range_count; ++i) {
+        const size_t boundary_position = document_ids_.size() * i / range_count;
+        it_id = next(it_id, boundary_position - position);
+        position = boundary_position;
+        range_boundaries_.push_back(*it_id);
+    }
+    writes_since_range_split_ = 0;
+}
+
+DocumentsPage SearchServer::SelectPage(vector<Document>& documents, size_t offset, size_t limit) {
+    DocumentsPage page;
+    if (offset >= documents.size() || limit == 0) {
+        return page;
+    }
+    const auto page_begin = documents.begin() + offset;
+    const auto page_end = page_begin + min(limit, documents.size() - offset);
+    if (offset > 0) {
+        nth_element(documents.begin(), page_begin, documents.end(), IsRankedBefore);
+    }
+    partial_sort(page_begin, page_end, documents.end(), IsRankedBefore);
+
+    page.documents.assign(page_begin, page_end);
+    if (page_end != documents.end()) {
+        page.next_cursor = PageCursor(page.documents.back());
+    }
+    return page;
+}
+
+size_t IndexMemoryStats::GetBytesInUse() const {
+    return dictionary.bytes_in_use + postings.bytes_in_use + forward_index.bytes_in_use + metadata.bytes_in_use;
+}
+
+size_t IndexMemoryStats::GetBytesReserved() const {
+    return dictionary.bytes_reserved + postings.bytes_reserved + forward_index.bytes_reserved + metadata.bytes_reserved;
+}
+
+double CorpusStatistics::ComputeInverseDocumentFreq(string_view word) const {
+    auto it_count = word_document_counts.find(word);
+    if (it_count == word_document_counts.end()) {
+        return 0.0;
+    }
+    return log(static_cast<double>(document_count) / it_count->second);
+}
+
+bool IsMoreRelevant(const Document& lhs, const Document& rhs) {
+    if (abs(lhs.relevance - rhs.relevance) < EPSILON) {
+        return lhs.rating > rhs.rating;
+    }
+    return lhs.relevance > rhs.relevance;
+}
+
+bool IsRankedBefore(const Document& lhs, const Document& rhs) {
+    if (IsMoreRelevant(lhs, rhs)) {
+        return true;
+    }
+    if (IsMoreRelevant(rhs, lhs)) {
+        return false;
+    }
+    return lhs.id < rhs.id;
 }
 
 void AddDocument(SearchServer& search_server, int document_id, const string& document, DocumentStatus status,
@@ -2,20 +2,74 @@
 #include <numeric>
 #include <cmath>
 #include <map>
+#include <memory>
+#include <memory_resource>
 #include <algorithm>
 #include <tuple>
 #include "document.h"
 #include "read_input_functions.h"
 #include <execution>
-#include "concurrent_map.h"
 #include <type_traits>
+#include <functional>
 #include <future>
+#include <thread>
+#include <limits>
+#include <optional>
 #include "log_duration.h"
 #include <iterator>
 #include <type_traits>
 #include <utility>
+#include "search_limits.h"
+#include "page_cursor.h"
+#include "term_dictionary.h"
+#include "tracked_memory_resource.h"
+using namespace std::string_literals;
 const int MAX_RESULT_DOCUMENT_COUNT = 5;
 const double EPSILON = 1e-6;
+const int SEARCH_LIMITS_CHECK_INTERVAL = 1024;
+const size_t MIN_DOCUMENTS_PER_RANGE = 1024;
+const size_t MAX_PREFIX_EXPANSION = 64;
+const size_t MAX_BATCH_BLOCK_SIZE = 64;
+
+bool IsMoreRelevant(const Document& lhs, const Document& rhs);
+// Total order of IsMoreRelevant with ties broken by document id, so that results
+// do not depend on how the scoring work was split
+bool IsRankedBefore(const Document& lhs, const Document& rhs);
+
+// Query words as written, without stop words and without expanding prefixes
+struct QueryTerms {
+    std::vector<std::string> plus_words;
+    std::vector<std::string> minus_words;
+    std::vector<std::string> plus_prefixes;
+    std::vector<std::string> minus_prefixes;
+};
+
+struct StructureMemoryStats {
+    size_t bytes_in_use = 0;
+    size_t bytes_reserved = 0;
+    size_t entry_count = 0;
+};
+
+struct IndexMemoryStats {
+    // Entries are distinct words
+    StructureMemoryStats dictionary;
+    // Entries are (word, document) pairs
+    StructureMemoryStats postings;
+    // Entries are (document, word) pairs
+    StructureMemoryStats forward_index;
+    // Entries are documents
+    StructureMemoryStats metadata;
+
+    size_t GetBytesInUse() const;
+    size_t GetBytesReserved() const;
+};
+
+struct CorpusStatistics {
+    int document_count = 0;
+    std::map<std::string, int, std::less<>> word_document_counts;
+
+    double ComputeInverseDocumentFreq(std::string_view word) const;
+};
 //using namespace std;
 class SearchServer {
 public:
@@ -33,27 +87,31 @@ public:
 
     void AddDocument(int document_id, const std::string_view& document, DocumentStatus status, const std::vector<int>& ratings);
 
+    using WordFrequencies = std::pmr::map<std::string_view, double>;
+    using DocumentAddedHandler = std::function<void(int document_id, DocumentStatus status, int rating,
+        const WordFrequencies& word_frequencies)>;
+    // Handlers are called in registration order at the end of every AddDocument and must
+    // not add or remove handlers. If a handler throws, the others still run and AddDocument
+    // rethrows the first exception; the document stays indexed.
+    // Returns the id to pass to RemoveDocumentAddedHandler.
+    int AddDocumentAddedHandler(DocumentAddedHandler handler);
+    void RemoveDocumentAddedHandler(int handler_id);
+
 
     template <typename Policy, typename DocumentPredicate>
     std::vector<Document> FindTopDocuments(const Policy& policy, std::string_view raw_query, DocumentPredicate document_predicate) const {
-        const auto query = ParseQuery(raw_query);
-
-        auto matched_documents = FindAllDocuments(policy, query, document_predicate);
+        return FindTopDocumentsForQuery(policy, ParseQuery(raw_query), document_predicate, MakeInverseDocumentFreq());
+    }
 
-        sort(policy, matched_documents.begin(), matched_documents.end(), [&](const Document& lhs, const Document& rhs) {
-            if (std::abs(lhs.relevance - rhs.relevance) < EPSILON) {
-                return lhs.rating > rhs.rating;
-            }
-            else {
-                return lhs.relevance > rhs.relevance;
-            }
+    // Ranks with IDF taken from statistics gathered over several indexes, so that
+    // shards of one corpus produce the same relevance as a single index would.
+    template <typename Policy, typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(const Policy& policy, std::string_view raw_query, DocumentPredicate document_predicate,
+        const CorpusStatistics& statistics) const {
+        return FindTopDocumentsForQuery(policy, ParseQuery(raw_query), document_predicate,
+            [&statistics](std::string_view word, size_t) {
+                return statistics.ComputeInverseDocumentFreq(word);
             });
-
-        if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
-            matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
-        }
-
-        return matched_documents;
     }
 
 
@@ -74,6 +132,122 @@ public:
     std::vector<Document> FindTopDocuments(const std::string_view& raw_query, DocumentStatus status) const;
     std::vector<Document> FindTopDocuments(const std::string_view& raw_query) const;
 
+    // Gives the same results as FindTopDocuments run for every query, but identical
+    // queries run once and every distinct word is looked up once for the whole batch.
+    // Queries are scored in blocks of at most MAX_BATCH_BLOCK_SIZE; queries sharing
+    // their longest posting list go to the same block, which scans each posting list
+    // once for all of its queries.
+    template <typename DocumentPredicate>
+    std::vector<std::vector<Document>> FindTopDocumentsBatch(const std::vector<std::string>& raw_queries,
+        DocumentPredicate document_predicate) const {
+        std::map<std::string_view, size_t> unique_query_indexes;
+        std::vector<size_t> query_to_unique(raw_queries.size());
+        std::vector<Query> unique_queries;
+        for (size_t i = 0; i < raw_queries.size(); ++i) {
+            const auto [it_query, inserted] = unique_query_indexes.emplace(raw_queries[i], unique_queries.size());
+            if (inserted) {
+                unique_queries.push_back(ParseQuery(raw_queries[i]));
+            }
+            query_to_unique[i] = it_query->second;
+        }
+
+        std::map<std::string_view, BatchWord> batch_words;
+        for (const Query& query : unique_queries) {
+            for (const std::string_view word : query.plus_words) {
+                batch_words[word];
+            }
+            for (const std::string_view word : query.minus_words) {
+                batch_words[word];
+            }
+        }
+        const auto inverse_document_freq_func = MakeInverseDocumentFreq();
+        for (auto& [word, batch_word] : batch_words) {
+            batch_word.postings = FindWordPostings(word);
+            if (batch_word.postings && !batch_word.postings->empty()) {
+                batch_word.inverse_document_freq = inverse_document_freq_func(word, batch_word.postings->size());
+            }
+        }
+
+        // Pairs of the word with the longest postings and the query index
+        std::vector<std::pair<std::string_view, size_t>> query_order;
+        query_order.reserve(unique_queries.size());
+        for (size_t query_index = 0; query_index < unique_queries.size(); ++query_index) {
+            std::string_view longest_word;
+            size_t longest_size = 0;
+            for (const std::string_view word : unique_queries[query_index].plus_words) {
+                const Postings* postings = batch_words.at(word).postings;
+                if (postings && postings->size() > longest_size) {
+                    longest_word = word;
+                    longest_size = postings->size();
+                }
+            }
+            query_order.emplace_back(longest_word, query_index);
+        }
+        std::sort(query_order.begin(), query_order.end());
+
+        std::vector<std::vector<Document>> unique_results(unique_queries.size());
+        std::vector<size_t> block;
+        for (size_t block_begin = 0; block_begin < query_order.size(); block_begin += MAX_BATCH_BLOCK_SIZE) {
+            const size_t block_end = std::min(block_begin + MAX_BATCH_BLOCK_SIZE, query_order.size());
+            block.clear();
+            for (size_t i = block_begin; i < block_end; ++i) {
+                block.push_back(query_order[i].second);
+            }
+            FindTopDocumentsForBlock(unique_queries, block, batch_words, document_predicate, unique_results);
+        }
+
+        std::vector<std::vector<Document>> results(raw_queries.size());
+        for (size_t i = 0; i < raw_queries.size(); ++i) {
+            results[i] = unique_results[query_to_unique[i]];
+        }
+        return results;
+    }
+    std::vector<std::vector<Document>> FindTopDocumentsBatch(const std::vector<std::string>& raw_queries) const;
+
+    // Only the first offset + limit documents of the result order get sorted,
+    // so deep pages do not require ordering the whole result.
+    template <typename Policy, typename DocumentPredicate>
+    DocumentsPage FindDocumentsPage(const Policy& policy, std::string_view raw_query, size_t offset, size_t limit,
+        DocumentPredicate document_predicate) const {
+        // One extra document tells SelectPage whether another page follows
+        const size_t result_limit = offset < std::numeric_limits<size_t>::max() - limit ? offset + limit + 1 : std::numeric_limits<size_t>::max();
+        auto matched_documents = FindAllDocuments(policy, ParseQuery(raw_query), document_predicate, MakeInverseDocumentFreq(), result_limit);
+        return SelectPage(matched_documents, offset, limit);
+    }
+
+    // Continues a previous page: only documents ranked after the cursor are ordered.
+    template <typename Policy, typename DocumentPredicate>
+    DocumentsPage FindDocumentsPage(const Policy& policy, std::string_view raw_query, const PageCursor& after, size_t limit,
+        DocumentPredicate document_predicate) const {
+        const size_t result_limit = limit < std::numeric_limits<size_t>::max() ? limit + 1 : limit;
+        auto matched_documents = FindAllDocuments(policy, ParseQuery(raw_query), document_predicate, MakeInverseDocumentFreq(), result_limit, &after);
+        return SelectPage(matched_documents, 0, limit);
+    }
+
+    DocumentsPage FindDocumentsPage(std::string_view raw_query, size_t offset, size_t limit) const;
+    DocumentsPage FindDocumentsPage(std::string_view raw_query, const PageCursor& after, size_t limit) const;
+
+    // Stops scanning postings once the deadline passes or the token is cancelled
+    // and returns the best documents found so far with is_partial set.
+    template <typename DocumentPredicate>
+    SearchResult FindTopDocuments(std::string_view raw_query, const SearchLimits& limits, DocumentPredicate document_predicate) const {
+        const auto query = ParseQuery(raw_query);
+
+        SearchResult result;
+        result.documents = FindAllDocuments(std::execution::seq, query, document_predicate, MakeInverseDocumentFreq(),
+            MAX_RESULT_DOCUMENT_COUNT, nullptr, &limits, &result.is_partial);
+
+        sort(result.documents.begin(), result.documents.end(), IsRankedBefore);
+
+        if (result.documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
+            result.documents.resize(MAX_RESULT_DOCUMENT_COUNT);
+        }
+
+        return result;
+    }
+    SearchResult FindTopDocuments(std::string_view raw_query, const SearchLimits& limits, DocumentStatus status) const;
+    SearchResult FindTopDocuments(std::string_view raw_query, const SearchLimits& limits) const;
+
     template <typename Policy>
     std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(Policy policy, const std::string_view& raw_query, int document_id)const {
 
@@ -82,27 +256,19 @@ public:
         }
 
         const auto query = ParseQuery(raw_query);
-        std::vector<std::string_view> matched_words(query.plus_words.size());
-        int count = 0;
-
-        std::copy_if(policy, query.plus_words.begin(), query.plus_words.end(), matched_words.begin(), [&](auto& word) {
-            if (word_to_document_freqs_.at(word).count(document_id))
-            {
-                count++;
-                return true;
-            }
-            return false;
-            });
+        const auto contains_word = [this, document_id](const std::string_view word) {
+            const auto* postings = FindWordPostings(word);
+            return postings && postings->count(document_id) > 0;
+        };
 
-        matched_words.resize(count);
+        std::vector<std::string_view> matched_words(query.plus_words.size());
+        const auto matched_end = std::copy_if(policy, query.plus_words.begin(), query.plus_words.end(), matched_words.begin(), contains_word);
+        matched_words.erase(matched_end, matched_words.end());
 
-        for_each(policy, query.minus_words.begin(), query.minus_words.end(), [&](auto word) {
-            if (word_to_document_freqs_.count(word)) {
-                if (word_to_document_freqs_.at(word).count(document_id)) {
-                    matched_words.clear();
-                }
-            }
-            });
+        if (std::any_of(policy, query.minus_words.begin(), query.minus_words.end(), contains_word)
+            || HasWordWithAnyPrefix(document_id, query.minus_prefixes)) {
+            matched_words.clear();
+        }
 
         return { matched_words, documents_.at(document_id).status };
 
@@ -112,26 +278,45 @@ public:
 
     std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(const std::string_view& raw_query, int document_id) const;
     int GetDocumentCount() const;
-    const std::map<std::string_view, double>& GetWordFrequencies(int document_id) const;
+    // Validates the query and splits it into words the way FindTopDocuments does
+    QueryTerms ParseQueryTerms(std::string_view raw_query) const;
+    // Adds this index's document count and the document counts of the query plus words.
+    void CollectCorpusStatistics(std::string_view raw_query, CorpusStatistics& statistics) const;
+    const WordFrequencies& GetWordFrequencies(int document_id) const;
+    static bool HasWordWithPrefix(const WordFrequencies& word_frequencies, std::string_view prefix);
 
     template <typename Policy>
     void RemoveDocument(Policy policy, int document_id) {
         if (documents_.count(document_id))
         {
-            auto word_frequencies(GetWordFrequencies(document_id));
+            const auto& word_frequencies = GetWordFrequencies(document_id);
             for_each(policy, word_frequencies.begin(), word_frequencies.end(),
-                [&document_id, this](std::pair<std::string_view, double> word) {
-                    word_to_document_freqs_.at(word.first).erase(document_id);
+                [&document_id, this](const auto& word) {
+                    word_postings_[*words_.Find(word.first)].erase(document_id);
                 });
             documents_.erase(document_id);
             document_ids_.erase(document_id);
             document_to_word_freqs_.erase(document_id);
+            UpdateDocumentRanges();
+            ++removals_since_compaction_;
+            CompactIfOverBudget();
         }
     }
 
     void RemoveDocument(int document_id);
-    std::set<int>::const_iterator begin() const;
-    std::set<int>::const_iterator end() const;
+    std::pmr::set<int>::const_iterator begin() const;
+    std::pmr::set<int>::const_iterator end() const;
+
+    IndexMemoryStats GetMemoryStats() const;
+    // The budget triggers compaction, it does not cap memory: the index may grow past it.
+    // RemoveDocument compacts the postings, forward index and metadata pools when the
+    // index reserves more than the budget, a quarter of those pools is unused and a
+    // quarter of the documents have been removed since the last compaction, so the
+    // rebuild cost is spread over the removals that caused it. Zero disables the budget.
+    void SetMemoryBudget(size_t bytes);
+    // Rebuilds postings, forward index and metadata into emptied pools,
+    // returning the memory lost to fragmentation to the system
+    void CompactMemory();
 
 private:
 
@@ -141,12 +326,30 @@ private:
         DocumentStatus status;
     };
 
-    const std::set<std::string> stop_words_;
-    std::set<std::string, std::less<>> string_words_;
-    std::map<std::string_view, std::map<int, double>> word_to_document_freqs_;
-    std::map<int, std::map<std::string_view, double>> document_to_word_freqs_;
-    std::map<int, DocumentData> documents_;
-    std::set<int> document_ids_;
+    using Postings = std::pmr::map<int, double>;
+
+    const std::set<std::string, std::less<>> stop_words_;
+    // Every index structure allocates from its own pool; the pools live on the heap
+    // so that moving the server leaves the containers' allocators valid
+    std::unique_ptr<TrackedMemoryResource> dictionary_memory_ = std::make_unique<TrackedMemoryResource>();
+    std::unique_ptr<TrackedMemoryResource> postings_memory_ = std::make_unique<TrackedMemoryResource>();
+    std::unique_ptr<TrackedMemoryResource> forward_index_memory_ = std::make_unique<TrackedMemoryResource>();
+    std::unique_ptr<TrackedMemoryResource> metadata_memory_ = std::make_unique<TrackedMemoryResource>();
+    size_t memory_budget_ = 0;
+    size_t removals_since_compaction_ = 0;
+
+    TermDictionary words_{ dictionary_memory_.get() };
+    // Postings of every word, indexed by its id in words_
+    std::pmr::vector<Postings> word_postings_{ postings_memory_.get() };
+    std::pmr::map<int, WordFrequencies> document_to_word_freqs_{ forward_index_memory_.get() };
+    std::pmr::map<int, DocumentData> documents_{ metadata_memory_.get() };
+    std::pmr::set<int> document_ids_{ metadata_memory_.get() };
+    std::map<int, DocumentAddedHandler> document_added_handlers_;
+    int next_document_added_handler_id_ = 0;
+    // Document ids splitting document_ids_ into ranges of nearly equal size for
+    // parallel scoring; refreshed once writes could unbalance a range by half
+    std::vector<int> range_boundaries_;
+    size_t writes_since_range_split_ = 0;
     bool IsStopWord(const std::string& word) const;
     bool IsStopWordView(const std::string_view word) const;
     static bool IsValidWord(const std::string_view word);
@@ -158,58 +361,244 @@ private:
         std::string_view data;
         bool is_minus;
         bool is_stop;
+        // The word ended with '*' and stands for the indexed words starting with data
+        bool is_prefix = false;
     };
     QueryWord ParseQueryWord(const std::string& text) const;
     QueryWord ParseQueryWordView(const std::string_view text) const;
     struct Query {
+        // Plus prefixes are expanded into plus_words
         std::vector<std::string_view> plus_words;
         std::vector<std::string_view> minus_words;
+        // Minus prefixes are not expanded: candidates are checked against the forward index
+        std::vector<std::string_view> minus_prefixes;
     };
     Query ParseQuery(std::string_view text) const;
-    double ComputeWordInverseDocumentFreq(const std::string& word) const;
+    const Postings* FindWordPostings(std::string_view word) const;
+    bool HasWordWithAnyPrefix(int document_id, const std::vector<std::string_view>& prefixes) const;
+    void CompactIfOverBudget();
+    struct ScoredPostings {
+        const Postings* postings;
+        double inverse_document_freq;
+    };
+    // Returns half-open id ranges covering every document id, each holding about the same number of documents
+    std::vector<std::pair<int64_t, int64_t>> SplitDocumentIds() const;
+    void UpdateDocumentRanges();
+    struct BatchWord {
+        const Postings* postings = nullptr;
+        double inverse_document_freq = 0.0;
+    };
+    static DocumentsPage SelectPage(std::vector<Document>& documents, size_t offset, size_t limit);
 
-    template <typename Policy, typename DocumentPredicate>
-    std::vector<Document> FindAllDocuments(const Policy& policy, const Query& query, DocumentPredicate document_predicate) const {
-        ConcurrentMap<int, double> document_relevance(documents_.size() > 100 ? documents_.size() / 100 : 4);
-        auto plus_words_func = [&](const std::string_view word) {
-            auto it_word = word_to_document_freqs_.find(word);
-            if (it_word == word_to_document_freqs_.end()) {
-                return;
-            }
-            auto& [_, docs_freqs] = *it_word;
-            const double inverse_document_freq = std::log(static_cast<double>(GetDocumentCount()) / docs_freqs.size());
-            for (const auto& [document_id, term_freq] : docs_freqs) {
-                const SearchServer::DocumentData& document_data = documents_.at(document_id);
-                if (document_predicate(document_id, document_data.status, document_data.rating)) {
-                    document_relevance[document_id].ref_to_value += term_freq * inverse_document_freq;
+    auto MakeInverseDocumentFreq() const {
+        return [this](std::string_view, size_t word_document_count) {
+            return std::log(static_cast<double>(GetDocumentCount()) / word_document_count);
+        };
+    }
+
+    template <typename Policy, typename DocumentPredicate, typename InverseDocumentFreq>
+    std::vector<Document> FindTopDocumentsForQuery(const Policy& policy, const Query& query, DocumentPredicate document_predicate,
+        InverseDocumentFreq inverse_document_freq_func) const {
+        auto matched_documents = FindAllDocuments(policy, query, document_predicate, inverse_document_freq_func, MAX_RESULT_DOCUMENT_COUNT);
+
+        sort(policy, matched_documents.begin(), matched_documents.end(), IsRankedBefore);
+
+        if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
+            matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
+        }
+
+        return matched_documents;
+    }
+
+    // Splits the documents into id ranges; each range is scored for all query words
+    // into its own accumulator and keeps only its best result_limit documents (ranked
+    // after the cursor, if given), so parallel workers never write to shared state.
+    // Only the type of the policy matters: sequential policies score a single range.
+    // With limits given, a range stops scanning plus postings once they are exceeded and
+    // sets *is_partial; its candidates are then checked for minus words in the forward
+    // index, so the remaining cost is bounded by the postings already scanned.
+    template <typename Policy, typename DocumentPredicate, typename InverseDocumentFreq>
+    std::vector<Document> FindAllDocuments(const Policy&, const Query& query, DocumentPredicate document_predicate,
+        InverseDocumentFreq inverse_document_freq_func, size_t result_limit = std::numeric_limits<size_t>::max(),
+        const PageCursor* after = nullptr, const SearchLimits* limits = nullptr, bool* is_partial = nullptr) const {
+        std::vector<ScoredPostings> plus_postings;
+        for (const std::string_view word : query.plus_words) {
+            const auto* postings = FindWordPostings(word);
+            if (postings && !postings->empty()) {
+                plus_postings.push_back({ postings, inverse_document_freq_func(word, postings->size()) });
+            }
+        }
+        std::vector<const Postings*> minus_postings;
+        for (const std::string_view word : query.minus_words) {
+            if (const auto* postings = FindWordPostings(word)) {
+                minus_postings.push_back(postings);
+            }
+        }
+        if (plus_postings.empty()) {
+            return {};
+        }
+
+        const std::optional<Document> last_document = after
+            ? std::optional<Document>(Document(after->document_id, after->relevance, after->rating))
+            : std::nullopt;
+        std::atomic_bool limits_exceeded = false;
+        const auto find_in_range = [&](const std::pair<int64_t, int64_t>& id_range) {
+            const auto [first_id, last_id] = id_range;
+            std::map<int, double> document_relevance;
+            size_t scanned_postings = 0;
+            bool is_range_partial = false;
+            for (const auto& [postings, inverse_document_freq] : plus_postings) {
+                for (auto it = postings->lower_bound(first_id); it != postings->end() && it->first < last_id; ++it) {
+                    if (limits && ++scanned_postings % SEARCH_LIMITS_CHECK_INTERVAL == 0
+                        && (limits_exceeded || limits->IsExceeded())) {
+                        limits_exceeded = is_range_partial = true;
+                        break;
+                    }
+                    const auto& [document_id, term_freq] = *it;
+                    const SearchServer::DocumentData& document_data = documents_.at(document_id);
+                    if (document_predicate(document_id, document_data.status, document_data.rating)) {
+                        document_relevance[document_id] += term_freq * inverse_document_freq;
+                    }
+                }
+                if (is_range_partial) {
+                    break;
+                }
+            }
+            if (is_range_partial) {
+                for (auto it = document_relevance.begin(); it != document_relevance.end();) {
+                    const auto& word_freqs = document_to_word_freqs_.at(it->first);
+                    const bool has_minus_word = std::any_of(query.minus_words.begin(), query.minus_words.end(),
+                        [&word_freqs](const std::string_view word) {
+                            return word_freqs.count(word) > 0;
+                        });
+                    it = has_minus_word ? document_relevance.erase(it) : std::next(it);
+                }
+            }
+            else {
+                for (const auto* postings : minus_postings) {
+                    for (auto it = postings->lower_bound(first_id); it != postings->end() && it->first < last_id; ++it) {
+                        document_relevance.erase(it->first);
+                    }
                 }
+            }
 
+            std::vector<Document> matched_documents;
+            matched_documents.reserve(document_relevance.size());
+            for (const auto& [document_id, relevance] : document_relevance) {
+                Document document(document_id, relevance, documents_.at(document_id).rating);
+                if ((!last_document || IsRankedBefore(*last_document, document))
+                    && !HasWordWithAnyPrefix(document_id, query.minus_prefixes)) {
+                    matched_documents.push_back(document);
+                }
             }
+            if (matched_documents.size() > result_limit) {
+                std::nth_element(matched_documents.begin(), matched_documents.begin() + result_limit, matched_documents.end(), IsRankedBefore);
+                matched_documents.resize(result_limit);
+            }
+            return matched_documents;
         };
 
-        std::for_each(policy, query.plus_words.begin(), query.plus_words.end(), plus_words_func);
+        std::vector<Document> matched_documents;
+        if constexpr (std::is_same_v<std::decay_t<Policy>, std::execution::sequenced_policy>) {
+            matched_documents = find_in_range({ std::numeric_limits<int>::min(), static_cast<int64_t>(std::numeric_limits<int>::max()) + 1 });
+        }
+        else {
+            const auto id_ranges = SplitDocumentIds();
+            std::vector<std::vector<Document>> range_documents(id_ranges.size());
+            std::transform(std::execution::par, id_ranges.begin(), id_ranges.end(), range_documents.begin(), find_in_range);
+
+            for (const auto& documents : range_documents) {
+                matched_documents.insert(matched_documents.end(), documents.begin(), documents.end());
+            }
+        }
+        if (is_partial && limits_exceeded) {
+            *is_partial = true;
+        }
+        return matched_documents;
+    }
+
+    // Scores the queries of one FindTopDocumentsBatch block. Document id ranges are scored
+    // in parallel; within a range every posting is visited once for all the block's queries
+    // that contain its word, and each range keeps only its best documents per query.
+    template <typename DocumentPredicate>
+    void FindTopDocumentsForBlock(const std::vector<Query>& queries, const std::vector<size_t>& block,
+        const std::map<std::string_view, BatchWord>& batch_words, DocumentPredicate document_predicate,
+        std::vector<std::vector<Document>>& results) const {
+        // Words in sorted order, as in FindAllDocuments, so the sums are bit-identical
+        std::map<std::string_view, std::pair<std::vector<size_t>, std::vector<size_t>>> block_words;
+        for (size_t position = 0; position < block.size(); ++position) {
+            for (const std::string_view word : queries[block[position]].plus_words) {
+                block_words[word].first.push_back(position);
+            }
+            for (const std::string_view word : queries[block[position]].minus_words) {
+                block_words[word].second.push_back(position);
+            }
+        }
 
-        std::for_each(policy, query.minus_words.begin(), query.minus_words.end(),
-            [this, &document_relevance](const auto minus_word) {
-                auto it_word = word_to_document_freqs_.find(minus_word);
-                if (it_word == word_to_document_freqs_.end()) {
-                    return;
+        const auto find_in_range = [&](const std::pair<int64_t, int64_t>& id_range) {
+            const auto [first_id, last_id] = id_range;
+            std::vector<std::map<int, double>> document_relevances(block.size());
+            for (const auto& [word, block_word] : block_words) {
+                const BatchWord& batch_word = batch_words.at(word);
+                if (!batch_word.postings || block_word.first.empty()) {
+                    continue;
                 }
-                auto& [_, docs_freqs] = *it_word;
-                for (const auto [id, _] : docs_freqs) {
-                    document_relevance.erase(id);
+                for (auto it = batch_word.postings->lower_bound(first_id); it != batch_word.postings->end() && it->first < last_id; ++it) {
+                    const auto& [document_id, term_freq] = *it;
+                    const DocumentData& document_data = documents_.at(document_id);
+                    if (!document_predicate(document_id, document_data.status, document_data.rating)) {
+                        continue;
+                    }
+                    const double relevance = term_freq * batch_word.inverse_document_freq;
+                    for (const size_t position : block_word.first) {
+                        document_relevances[position][document_id] += relevance;
+                    }
                 }
-            });
+            }
+            for (const auto& [word, block_word] : block_words) {
+                const BatchWord& batch_word = batch_words.at(word);
+                if (!batch_word.postings || block_word.second.empty()) {
+                    continue;
+                }
+                for (auto it = batch_word.postings->lower_bound(first_id); it != batch_word.postings->end() && it->first < last_id; ++it) {
+                    for (const size_t position : block_word.second) {
+                        document_relevances[position].erase(it->first);
+                    }
+                }
+            }
 
-        std::vector<Document> matched_documents;
-        auto doc_rel = document_relevance.BuildOrdinaryMap();
-        matched_documents.reserve(doc_rel.size());
+            std::vector<std::vector<Document>> range_results(block.size());
+            for (size_t position = 0; position < block.size(); ++position) {
+                auto& matched_documents = range_results[position];
+                for (const auto& [document_id, relevance] : document_relevances[position]) {
+                    if (!HasWordWithAnyPrefix(document_id, queries[block[position]].minus_prefixes)) {
+                        matched_documents.push_back({ document_id, relevance, documents_.at(document_id).rating });
+                    }
+                }
+                if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
+                    std::nth_element(matched_documents.begin(), matched_documents.begin() + MAX_RESULT_DOCUMENT_COUNT,
+                        matched_documents.end(), IsRankedBefore);
+                    matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
+                }
+                document_relevances[position].clear();
+            }
+            return range_results;
+        };
 
-        for (auto& [document_id, relevance] : doc_rel) {
-            matched_documents.push_back({ document_id, relevance, documents_.at(document_id).rating });
-        }
+        const auto id_ranges = SplitDocumentIds();
+        std::vector<std::vector<std::vector<Document>>> range_results(id_ranges.size());
+        std::transform(std::execution::par, id_ranges.begin(), id_ranges.end(), range_results.begin(), find_in_range);
 
-        return matched_documents;
+        for (size_t position = 0; position < block.size(); ++position) {
+            auto& matched_documents = results[block[position]];
+            for (const auto& range_documents : range_results) {
+                matched_documents.insert(matched_documents.end(), range_documents[position].begin(), range_documents[position].end());
+            }
+            sort(matched_documents.begin(), matched_documents.end(), IsRankedBefore);
+            if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
+                matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
+            }
+        }
     }
 
 };
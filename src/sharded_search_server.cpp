@@ -0,0 +1,65 @@
+#include "sharded_search_server.h"
+using namespace std;
+
+ShardedSearchServer::ShardedSearchServer(const string& stop_words_text, size_t shard_count)
+    : ShardedSearchServer(SplitIntoWords(stop_words_text), shard_count)
+{
+}
+
+void ShardedSearchServer::AddDocument(int document_id, string_view document, DocumentStatus status, const vector<int>& ratings) {
+    Shard& shard = GetShard(document_id);
+    lock_guard lock(shard.mutex);
+    shard.server.AddDocument(document_id, document, status, ratings);
+}
+
+void ShardedSearchServer::RemoveDocument(int document_id) {
+    Shard& shard = GetShard(document_id);
+    lock_guard lock(shard.mutex);
+    shard.server.RemoveDocument(document_id);
+}
+
+vector<Document> ShardedSearchServer::FindTopDocuments(string_view raw_query, DocumentStatus status) const {
+    return FindTopDocuments(raw_query, [status](int document_id, DocumentStatus document_status, int rating) {
+        return document_status == status;
+        });
+}
+
+vector<Document> ShardedSearchServer::FindTopDocuments(string_view raw_query) const {
+    return FindTopDocuments(raw_query, DocumentStatus::ACTUAL);
+}
+
+tuple<vector<string_view>, DocumentStatus> ShardedSearchServer::MatchDocument(string_view raw_query, int document_id) const {
+    const Shard& shard = GetShard(document_id);
+    shared_lock lock(shard.mutex);
+    return shard.server.MatchDocument(raw_query, document_id);
+}
+
+int ShardedSearchServer::GetDocumentCount() const {
+    const auto locks = LockAllShared();
+    int document_count = 0;
+    for (const Shard& shard : shards_) {
+        document_count += shard.server.GetDocumentCount();
+    }
+    return document_count;
+}
+
+size_t ShardedSearchServer::GetShardCount() const {
+    return shards_.size();
+}
+
+vector<shared_lock<shared_mutex>> ShardedSearchServer::LockAllShared() const {
+    vector<shared_lock<shared_mutex>> locks;
+    locks.reserve(shards_.size());
+    for (const Shard& shard : shards_) {
+        locks.emplace_back(shard.mutex);
+    }
+    return locks;
+}
+
+const ShardedSearchServer::Shard& ShardedSearchServer::GetShard(int document_id) const {
+    return shards_[static_cast<size_t>(document_id) % shards_.size()];
+}
+
+ShardedSearchServer::Shard& ShardedSearchServer::GetShard(int document_id) {
+    return shards_[static_cast<size_t>(document_id) % shards_.size()];
+}
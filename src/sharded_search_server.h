@@ -0,0 +1,85 @@
+#pragma once
+#include "search_server.h"
+#include <deque>
+#include <shared_mutex>
+
+// Partitions documents across several SearchServer shards by document id.
+// Writes lock only the owning shard; queries fan out to every shard and merge
+// the local top documents, ranking with statistics of the whole corpus.
+class ShardedSearchServer {
+public:
+    template <typename StringContainer>
+    ShardedSearchServer(const StringContainer& stop_words, size_t shard_count) {
+        if (shard_count == 0) {
+            throw std::invalid_argument("Shard count must be positive");
+        }
+        for (size_t i = 0; i < shard_count; ++i) {
+            shards_.emplace_back(stop_words);
+        }
+    }
+    ShardedSearchServer(const std::string& stop_words_text, size_t shard_count);
+
+    void AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
+    void RemoveDocument(int document_id);
+
+    template <typename Policy, typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(const Policy& policy, std::string_view raw_query, DocumentPredicate document_predicate) const {
+        // Statistics and scores come from the same snapshot: every shard stays
+        // read-locked for the whole query. Shards are locked in index order and
+        // writers hold a single shard, so readers cannot deadlock.
+        const auto locks = LockAllShared();
+
+        CorpusStatistics statistics;
+        for (const Shard& shard : shards_) {
+            shard.server.CollectCorpusStatistics(raw_query, statistics);
+        }
+
+        std::vector<std::vector<Document>> shard_documents(shards_.size());
+        std::transform(policy, shards_.begin(), shards_.end(), shard_documents.begin(),
+            [&](const Shard& shard) {
+                return shard.server.FindTopDocuments(std::execution::seq, raw_query, document_predicate, statistics);
+            });
+
+        std::vector<Document> matched_documents;
+        for (auto& documents : shard_documents) {
+            matched_documents.insert(matched_documents.end(), documents.begin(), documents.end());
+        }
+
+        sort(matched_documents.begin(), matched_documents.end(), IsRankedBefore);
+
+        if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
+            matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
+        }
+
+        return matched_documents;
+    }
+
+    template <typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate) const {
+        return FindTopDocuments(std::execution::par, raw_query, document_predicate);
+    }
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentStatus status) const;
+    std::vector<Document> FindTopDocuments(std::string_view raw_query) const;
+
+    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(std::string_view raw_query, int document_id) const;
+    int GetDocumentCount() const;
+    size_t GetShardCount() const;
+
+private:
+    struct Shard {
+        template <typename StringContainer>
+        explicit Shard(const StringContainer& stop_words)
+            : server(stop_words)
+        {
+        }
+
+        mutable std::shared_mutex mutex;
+        SearchServer server;
+    };
+
+    std::deque<Shard> shards_;
+
+    std::vector<std::shared_lock<std::shared_mutex>> LockAllShared() const;
+    const Shard& GetShard(int document_id) const;
+    Shard& GetShard(int document_id);
+};
@@ -6,8 +6,8 @@
 std::vector<std::string> SplitIntoWords(const std::string & text);
 std::vector<std::string_view> SplitIntoWordsView(const std::string_view str);
 template <typename StringContainer>
-std::set<std::string> MakeUniqueNonEmptyStrings(const StringContainer& strings) {
-    std::set<std::string> non_empty_strings;
+std::set<std::string, std::less<>> MakeUniqueNonEmptyStrings(const StringContainer& strings) {
+    std::set<std::string, std::less<>> non_empty_strings;
     for (const auto& str : strings) {
         if (!str.empty()) {
             non_empty_strings.insert(std::string{ str });
@@ -0,0 +1,90 @@
+#include "term_dictionary.h"
+#include <algorithm>
+#include <cstring>
+using namespace std;
+
+TermDictionary::TermDictionary(pmr::memory_resource* resource)
+    : arena_blocks_(resource)
+    , terms_(resource)
+    , sorted_term_ids_(resource)
+    , delta_(resource)
+{
+}
+
+optional<uint32_t> TermDictionary::Find(string_view term) const {
+    const auto it_sorted = FindSorted(term);
+    if (it_sorted != sorted_term_ids_.end() && terms_[*it_sorted] == term) {
+        return *it_sorted;
+    }
+    const auto it_delta = delta_.find(term);
+    if (it_delta != delta_.end()) {
+        return it_delta->second;
+    }
+    return nullopt;
+}
+
+uint32_t TermDictionary::Insert(string_view term) {
+    if (const auto term_id = Find(term)) {
+        return *term_id;
+    }
+    const uint32_t term_id = static_cast<uint32_t>(terms_.size());
+    terms_.push_back(StoreTerm(term));
+    delta_.emplace(terms_.back(), term_id);
+    if (delta_.size() > max(MIN_DELTA_SIZE, sorted_term_ids_.size() / 16)) {
+        Compact();
+    }
+    return term_id;
+}
+
+string_view TermDictionary::GetTerm(uint32_t term_id) const {
+    return terms_.at(term_id);
+}
+
+size_t TermDictionary::size() const {
+    return terms_.size();
+}
+
+vector<uint32_t> TermDictionary::FindByPrefix(string_view prefix, size_t max_count) const {
+    return FindByPrefix(prefix, max_count, [](uint32_t) {
+        return true;
+        });
+}
+
+void TermDictionary::Compact() {
+    if (delta_.empty()) {
+        return;
+    }
+    pmr::vector<uint32_t> merged_ids(sorted_term_ids_.get_allocator());
+    merged_ids.reserve(sorted_term_ids_.size() + delta_.size());
+    auto it_delta = delta_.begin();
+    for (const uint32_t term_id : sorted_term_ids_) {
+        for (; it_delta != delta_.end() && it_delta->first < terms_[term_id]; ++it_delta) {
+            merged_ids.push_back(it_delta->second);
+        }
+        merged_ids.push_back(term_id);
+    }
+    for (; it_delta != delta_.end(); ++it_delta) {
+        merged_ids.push_back(it_delta->second);
+    }
+    sorted_term_ids_ = move(merged_ids);
+    delta_.clear();
+}
+
+string_view TermDictionary::StoreTerm(string_view term) {
+    if (ARENA_BLOCK_SIZE - arena_block_used_ < term.size()) {
+        // Oversized terms get a block of their own, which is never appended to
+        const size_t block_size = max(ARENA_BLOCK_SIZE, term.size());
+        arena_blocks_.emplace_back(block_size);
+        arena_block_used_ = 0;
+    }
+    char* data = arena_blocks_.back().data() + arena_block_used_;
+    memcpy(data, term.data(), term.size());
+    arena_block_used_ = term.size() > ARENA_BLOCK_SIZE ? ARENA_BLOCK_SIZE : arena_block_used_ + term.size();
+    return { data, term.size() };
+}
+
+pmr::vector<uint32_t>::const_iterator TermDictionary::FindSorted(string_view term) const {
+    return lower_bound(sorted_term_ids_.begin(), sorted_term_ids_.end(), term, [this](uint32_t term_id, string_view value) {
+        return terms_[term_id] < value;
+        });
+}
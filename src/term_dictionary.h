@@ -0,0 +1,78 @@
+#pragma once
+#include <cstdint>
+#include <map>
+#include <memory_resource>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+// Maps distinct terms to dense ids 0, 1, 2, ... in insertion order.
+// Term bytes are stored back to back in an append-only arena, so the string_views
+// returned by GetTerm stay valid for the lifetime of the dictionary. Lookups use
+// an immutable array of ids sorted by term plus a small sorted delta of recently
+// added terms, which is merged into the array once it outgrows a fraction of it.
+class TermDictionary {
+public:
+    explicit TermDictionary(std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+
+    // Copies would point into the arena of the original
+    TermDictionary(const TermDictionary&) = delete;
+    TermDictionary& operator=(const TermDictionary&) = delete;
+    TermDictionary(TermDictionary&&) = default;
+    TermDictionary& operator=(TermDictionary&&) = delete;
+
+    std::optional<uint32_t> Find(std::string_view term) const;
+    // Returns the id of the term, adding it when it is new
+    uint32_t Insert(std::string_view term);
+    std::string_view GetTerm(uint32_t term_id) const;
+    size_t size() const;
+
+    // Returns ids of terms starting with prefix in lexicographic order, at most max_count of them
+    std::vector<uint32_t> FindByPrefix(std::string_view prefix, size_t max_count) const;
+
+    // Same, but skips the terms whose ids the predicate rejects; they do not count towards max_count
+    template <typename TermIdPredicate>
+    std::vector<uint32_t> FindByPrefix(std::string_view prefix, size_t max_count, TermIdPredicate term_id_predicate) const {
+        const auto starts_with_prefix = [prefix](std::string_view term) {
+            return term.substr(0, prefix.size()) == prefix;
+        };
+        std::vector<uint32_t> term_ids;
+        auto it_sorted = FindSorted(prefix);
+        auto it_delta = delta_.lower_bound(prefix);
+        while (term_ids.size() < max_count) {
+            const bool has_sorted = it_sorted != sorted_term_ids_.end() && starts_with_prefix(terms_[*it_sorted]);
+            const bool has_delta = it_delta != delta_.end() && starts_with_prefix(it_delta->first);
+            if (!has_sorted && !has_delta) {
+                break;
+            }
+            uint32_t term_id;
+            if (has_sorted && (!has_delta || terms_[*it_sorted] < it_delta->first)) {
+                term_id = *it_sorted++;
+            }
+            else {
+                term_id = it_delta->second;
+                ++it_delta;
+            }
+            if (term_id_predicate(term_id)) {
+                term_ids.push_back(term_id);
+            }
+        }
+        return term_ids;
+    }
+
+    // Merges the delta into the sorted array
+    void Compact();
+
+private:
+    static constexpr size_t ARENA_BLOCK_SIZE = 64 * 1024;
+    static constexpr size_t MIN_DELTA_SIZE = 1024;
+
+    std::pmr::vector<std::pmr::vector<char>> arena_blocks_;
+    size_t arena_block_used_ = ARENA_BLOCK_SIZE;
+    std::pmr::vector<std::string_view> terms_;
+    std::pmr::vector<uint32_t> sorted_term_ids_;
+    std::pmr::map<std::string_view, uint32_t> delta_;
+
+    std::string_view StoreTerm(std::string_view term);
+    std::pmr::vector<uint32_t>::const_iterator FindSorted(std::string_view term) const;
+};
@@ -0,0 +1,50 @@
+#include "tracked_memory_resource.h"
+using namespace std;
+
+TrackedMemoryResource::TrackedMemoryResource()
+    : pool_(&upstream_)
+{
+}
+
+size_t TrackedMemoryResource::GetBytesInUse() const {
+    return bytes_in_use_.load(memory_order_relaxed);
+}
+
+size_t TrackedMemoryResource::GetBytesReserved() const {
+    return upstream_.bytes.load(memory_order_relaxed);
+}
+
+void TrackedMemoryResource::Release() {
+    pool_.release();
+    bytes_in_use_ = 0;
+}
+
+void* TrackedMemoryResource::do_allocate(size_t bytes, size_t alignment) {
+    void* p = pool_.allocate(bytes, alignment);
+    bytes_in_use_.fetch_add(bytes, memory_order_relaxed);
+    return p;
+}
+
+void TrackedMemoryResource::do_deallocate(void* p, size_t bytes, size_t alignment) {
+    pool_.deallocate(p, bytes, alignment);
+    bytes_in_use_.fetch_sub(bytes, memory_order_relaxed);
+}
+
+bool TrackedMemoryResource::do_is_equal(const pmr::memory_resource& other) const noexcept {
+    return this == &other;
+}
+
+void* TrackedMemoryResource::CountingResource::do_allocate(size_t bytes, size_t alignment) {
+    void* p = pmr::new_delete_resource()->allocate(bytes, alignment);
+    this->bytes.fetch_add(bytes, memory_order_relaxed);
+    return p;
+}
+
+void TrackedMemoryResource::CountingResource::do_deallocate(void* p, size_t bytes, size_t alignment) {
+    pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+    this->bytes.fetch_sub(bytes, memory_order_relaxed);
+}
+
+bool TrackedMemoryResource::CountingResource::do_is_equal(const pmr::memory_resource& other) const noexcept {
+    return this == &other;
+}
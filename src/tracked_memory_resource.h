@@ -0,0 +1,37 @@
+#pragma once
+#include <atomic>
+#include <memory_resource>
+
+// Pool for the containers of one index structure. Counts the bytes the containers
+// hold and the bytes the pool has taken from the system; the difference is memory
+// lost to fragmentation that Release can return once the containers are emptied.
+class TrackedMemoryResource : public std::pmr::memory_resource {
+public:
+    TrackedMemoryResource();
+
+    size_t GetBytesInUse() const;
+    size_t GetBytesReserved() const;
+
+    // Returns all pooled memory to the system; containers using the resource must hold no memory
+    void Release();
+
+private:
+    class CountingResource : public std::pmr::memory_resource {
+    public:
+        std::atomic<size_t> bytes = 0;
+
+    private:
+        void* do_allocate(size_t bytes, size_t alignment) override;
+        void do_deallocate(void* p, size_t bytes, size_t alignment) override;
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+    };
+
+    CountingResource upstream_;
+    // Synchronized because RemoveDocument may erase postings in parallel
+    std::pmr::synchronized_pool_resource pool_;
+    std::atomic<size_t> bytes_in_use_ = 0;
+
+    void* do_allocate(size_t bytes, size_t alignment) override;
+    void do_deallocate(void* p, size_t bytes, size_t alignment) override;
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+};